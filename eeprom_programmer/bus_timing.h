@@ -0,0 +1,69 @@
+#ifndef __bus_timing_h__
+#define __bus_timing_h__
+
+// Bus Timing
+// the datasheet figures of a chip in ns and the delays that cover them in CPU cycles, computed
+// from F_CPU by the compiler: every chip descriptor holds its own `BusTiming`
+//
+// the delays run the avr-libc delay loop (_delay_loop_1), 3 cycles per loop: 187.5 ns at
+// 16 MHz instead of the 1 us of delayMicroseconds. They cover the figure alone, the pin calls
+// around them only add to it
+
+#if defined(__AVR__)
+#include <util/delay_basic.h>
+#endif
+
+namespace BusTimingLibrary {
+
+// _delay_loop_1: dec + brne
+static constexpr uint8_t DELAY_LOOP_CYCLES = 3;
+
+// the cycles of the CPU clock covering `nsec`, rounded up
+constexpr uint32_t nsec_to_cycles(const uint16_t nsec) {
+  return ((uint32_t)nsec * (F_CPU / 1000UL) + 999999UL) / 1000000UL;
+}
+
+constexpr uint32_t cycles_to_loops(const uint32_t cycles) {
+  return (cycles + DELAY_LOOP_CYCLES - 1) / DELAY_LOOP_CYCLES;
+}
+
+// the delay loops covering `nsec`, rounded up; 255 loops are 47 us at 16 MHz
+constexpr uint8_t nsec_to_loops(const uint16_t nsec) {
+  return cycles_to_loops(nsec_to_cycles(nsec)) > 255 ? 255 : (uint8_t)cycles_to_loops(nsec_to_cycles(nsec));
+}
+
+constexpr uint16_t max_nsec(const uint16_t a_nsec, const uint16_t b_nsec) {
+  return a_nsec > b_nsec ? a_nsec : b_nsec;
+}
+
+struct BusTiming {
+  uint16_t t_acc_nsec;  // address to output delay
+  uint16_t t_oe_nsec;   // !OE to output delay
+  uint16_t t_wp_nsec;   // !WE pulse width
+  uint16_t t_ds_nsec;   // data setup to the rising edge of !WE
+  // !OE low to the data read: the slower of tACC and tOE, the address is set just before
+  uint8_t output_delay_loops;
+  // !WE low to !WE high: the data is on the bus before !WE falls, the pulse covers tWP and tDS
+  uint8_t write_pulse_loops;
+};
+
+// a `BusTiming` of the chip descriptor table
+constexpr BusTiming bus_timing_nsec(const uint16_t t_acc_nsec, const uint16_t t_oe_nsec, const uint16_t t_wp_nsec,
+                                    const uint16_t t_ds_nsec) {
+  return BusTiming{
+    t_acc_nsec, t_oe_nsec, t_wp_nsec, t_ds_nsec,
+    nsec_to_loops(max_nsec(t_acc_nsec, t_oe_nsec)),
+    nsec_to_loops(max_nsec(t_wp_nsec, t_ds_nsec)),
+  };
+}
+
+// 0 loops is no delay, _delay_loop_1(0) would run 256
+inline void delay_loops(const uint8_t loops) {
+  if (loops != 0) {
+    _delay_loop_1(loops);
+  }
+}
+
+}  // BusTimingLibrary
+
+#endif  // !__bus_timing_h__
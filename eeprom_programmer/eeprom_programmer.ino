@@ -1,141 +1,434 @@
+// uncomment to record the stage trace for `dump_trace`, 7 bytes of SRAM per record
+// #define STAGE_TRACE_DEPTH 64
+
+// uncomment to time RDY/!BUSY by its pin-change interrupt when the pin has no capture or INT,
+// the firmware then owns the PCINT vectors and SoftwareSerial does not link
+// #define PIN_EDGE_PCINT
+
+// the socket wiring of the board: DIP28, or DIP28_SHIFT with the address bus on two 74HC595 over SPI
+#ifndef EEPROM_PROGRAMMER_WIRING
+#define EEPROM_PROGRAMMER_WIRING DIP28
+#endif
+
+// uncomment on a board with socket pin 1 (RDY/!BUSY) rewired from pin 29, see eeprom_programmer_wiring.h:
+// 48 captures the end of the write cycle on DIP28, 2 or 3 take it in the INT4/INT5 interrupt
+// #define DIP28_SOCKET_PIN1 48
+
 #include "eeprom_programmer_wiring.h"
 #include "eeprom_programmer_lib.h"
+#include "instrument_clock.h"
+#include "latency_histogram.h"
+#include "memory_stats.h"
 #include "serial_json_rpc_lib.h"
+#include "stage_trace.h"
 
 using namespace EepromProgrammerLibrary;
 using namespace EepromProgrammerWiring;
+using namespace InstrumentClockLibrary;
+using namespace LatencyHistogramLibrary;
+using namespace MemoryStatsLibrary;
 using namespace SerialJsonRpcLibrary;
+using namespace StageTraceLibrary;
 
 
 // EEPROM Programmer
 
-static EepromProgrammer eeprom_programmer(WiringType::DIP28);
+static EepromProgrammer eeprom_programmer(WiringType::EEPROM_PROGRAMMER_WIRING);
+
+// stage timing of the programmer calls, the rpc board keeps the parse and send times
+static unsigned long stage_bus_io_usec = 0;
+static unsigned long stage_write_wait_usec = 0;
+
+// latency distributions for `get_stats`, the programmer and the rpc board keep the others
+static LatencyHistogram bus_read_page_histogram;
+
+// the `write_page` request of the page in progress, answered from `loop()` when the page ends
+static bool write_request_pending = false;
+static int write_request_id = 0;
+static int write_request_page_no = 0;
+static uint32_t write_request_start_ticks = 0;
+
+// one more `write_page` received while the page is written, `write_loop` starts it when the page
+// ends; a third one is rejected with WRITE_IN_PROGRESS, `cancel_write` drops the held one
+static bool write_queued = false;
+static int write_queued_id = 0;
+static int write_queued_page_no = 0;
+static size_t write_queued_size = 0;
+static uint8_t write_queued_bytes[EepromProgrammer::MAX_PAGE_SIZE];
 
 
 // Serial JSON RPC Processor
 
 static SerialJsonRpcBoard rpc_board(rpc_processor);
 
-void rpc_processor(int request_id, const String &method, const String params[], int params_size) {
-  if (method == "init_chip") {
+// the counters are unsigned, the client reads them back as unsigned
+static void add_histogram_to_result(const LatencyHistogram& histogram) {
+  rpc_board.add_result_array_int((int32_t)histogram.get_count());
+  rpc_board.add_result_array_int((int32_t)histogram.get_min_usec());
+  rpc_board.add_result_array_int((int32_t)histogram.get_max_usec());
+  rpc_board.add_result_array_int((int32_t)histogram.get_sum_usec());
+  for (uint8_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+    rpc_board.add_result_array_int((int32_t)histogram.get_bucket(i));
+  }
+}
+
+static bool is_method(const char* method, PGM_P name) {
+  return strcmp_P(method, name) == 0;
+}
+
+// the page is written by `write_loop`, the request is answered there or now when it cannot start
+static void begin_write_request(const int request_id, const int page_no, const uint8_t* bytes, const size_t bytes_size) {
+  ErrorCode code = eeprom_programmer.begin_write_page(page_no, bytes, bytes_size);
+  if (code != ErrorCode::SUCCESS) {
+    rpc_board.send_error_P(request_id, -32031, PSTR("Service error"), PSTR("Failed to WRITE page %d with error: %d"), page_no, code);
+    return;
+  }
+  write_request_pending = true;
+  write_request_id = request_id;
+  write_request_page_no = page_no;
+  write_request_start_ticks = instrument_ticks();
+}
+
+// the held page ends without a write, its request is answered with WRITE_CANCELLED
+static void drop_queued_write() {
+  if (!write_queued) {
+    return;
+  }
+  write_queued = false;
+  rpc_board.send_error_P(write_queued_id, -32031, PSTR("Service error"), PSTR("Failed to WRITE page %d with error: %d"), write_queued_page_no, ErrorCode::WRITE_CANCELLED);
+}
+
+void rpc_processor(int request_id, const char* method, JsonArray params) {
+  const size_t params_size = params.size();
+
+  if (is_method(method, PSTR("init_chip"))) {
     if (params_size != 1) {
-      rpc_board.send_error(request_id, -32602, "Invalid params", "expected: (chip_type)");
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (chip_type)"));
       return;
     }
-    String chip_type = params[0];
+    const char* chip_type = params[0] | "";
 
     ErrorCode code = eeprom_programmer.init_chip(chip_type);
     if (code != ErrorCode::SUCCESS) {
-      const size_t error_data_buf_size = 50;
-      char error_data_buf[error_data_buf_size];
-      snprintf(error_data_buf, error_data_buf_size, "Failed to init %s chip with error: %d", chip_type.c_str(), code);
-      rpc_board.send_error(request_id, -32010, "Service error", error_data_buf);
+      rpc_board.send_error_P(request_id, -32010, PSTR("Service error"), PSTR("Failed to init %s chip with error: %d"), chip_type, code);
       return;
     }
 
+    // the chip descriptor follows the programmer settings
+    const ChipDescriptor& chip = eeprom_programmer.get_chip_descriptor();
     int32_t chip_settings[] = {
-      eeprom_programmer.get_memory_size_bytes(),
-      eeprom_programmer.get_max_page_size(),
+      (int32_t)eeprom_programmer.get_memory_size_bytes(),
+      (int32_t)eeprom_programmer.get_max_page_size(),
+      chip.write_page_size,
+      chip.write_cycle_max_usec,
+      chip.write_completion,
+      chip.features,
+      eeprom_programmer.get_write_timing(),
     };
     rpc_board.send_result_ints(request_id, chip_settings, sizeof(chip_settings) / sizeof(chip_settings[0]));
 
-  } else if (method == "set_read_mode") {
+  } else if (is_method(method, PSTR("set_read_mode"))) {
     if (params_size != 1) {
-      rpc_board.send_error(request_id, -32602, "Invalid params", "expected: (read_page_size_bytes)");
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (read_page_size_bytes)"));
       return;
     }
-    const int read_page_size_bytes = atoi(params[0].c_str());
+    const int read_page_size_bytes = params[0].as<int>();
 
     ErrorCode code = eeprom_programmer.set_read_mode(read_page_size_bytes);
     if (code != ErrorCode::SUCCESS) {
-      const size_t error_data_buf_size = 70;
-      char error_data_buf[error_data_buf_size];
-      snprintf(error_data_buf, error_data_buf_size, "Failed to set READ mode for page size %d with error: %d", read_page_size_bytes, code);
-      rpc_board.send_error(request_id, -32020, "Service error", error_data_buf);
+      rpc_board.send_error_P(request_id, -32020, PSTR("Service error"), PSTR("Failed to set READ mode for page size %d with error: %d"), read_page_size_bytes, code);
       return;
     }
 
-    const size_t result_buf_size = 50;
-    char result_buf[result_buf_size];
-    snprintf(result_buf, result_buf_size, "READ mode is ON for %d bytes pages", read_page_size_bytes);
-    rpc_board.send_result_string(request_id, result_buf);
+    rpc_board.send_result_string_P(request_id, PSTR("READ mode is ON for %d bytes pages"), read_page_size_bytes);
 
-  } else if (method == "read_page") {
+  } else if (is_method(method, PSTR("read_page"))) {
     if (params_size != 1) {
-      rpc_board.send_error(request_id, -32602, "Invalid params", "expected: (page_no)");
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (page_no)"));
       return;
     }
-    const int page_no = atoi(params[0].c_str());
+    const int page_no = params[0].as<int>();
 
     const size_t page_size = eeprom_programmer.get_page_size_bytes();
     uint8_t buffer[page_size];
 
+    const uint32_t bus_start_ticks = instrument_ticks();
     ErrorCode code = eeprom_programmer.read_page(page_no, buffer);
+    const unsigned long bus_read_usec = ticks_to_usec(instrument_ticks() - bus_start_ticks);
+    stage_bus_io_usec += bus_read_usec;
     if (code != ErrorCode::SUCCESS) {
-      const size_t error_data_buf_size = 70;
-      char error_data_buf[error_data_buf_size];
-      snprintf(error_data_buf, error_data_buf_size, "Failed to READ page %d with error: %d", page_no, code);
-      rpc_board.send_error(request_id, -32021, "Service error", error_data_buf);
+      rpc_board.send_error_P(request_id, -32021, PSTR("Service error"), PSTR("Failed to READ page %d with error: %d"), page_no, code);
       return;
     }
+    bus_read_page_histogram.add(bus_read_usec);
 
     rpc_board.send_result_bytes(request_id, buffer, page_size);
 
-  } else if (method == "set_write_mode") {
+  } else if (is_method(method, PSTR("hash_range"))) {
+    if (params_size != 3) {
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (start_address, length, algorithm)"));
+      return;
+    }
+    const uint32_t start_address = params[0].as<uint32_t>();
+    const uint32_t length = params[1].as<uint32_t>();
+    const HashAlgorithm algorithm = str_to_hash_algorithm(params[2] | "");
+
+    uint32_t digest = 0;
+    const uint32_t bus_start_ticks = instrument_ticks();
+    ErrorCode code = eeprom_programmer.hash_range(start_address, length, algorithm, digest);
+    stage_bus_io_usec += ticks_to_usec(instrument_ticks() - bus_start_ticks);
+    if (code != ErrorCode::SUCCESS) {
+      rpc_board.send_error_P(request_id, -32022, PSTR("Service error"), PSTR("Failed to HASH %lu bytes at %lu with error: %d"), (unsigned long)length, (unsigned long)start_address, code);
+      return;
+    }
+
+    // CRC32 does not fit int32, the client reads the digest as unsigned
+    int32_t result[] = { (int32_t)digest };
+    rpc_board.send_result_ints(request_id, result, sizeof(result) / sizeof(result[0]));
+
+  } else if (is_method(method, PSTR("page_crc_table"))) {
+    if (params_size != 1) {
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (page_size_bytes)"));
+      return;
+    }
+    const uint32_t page_size_bytes = params[0].as<uint32_t>();
+
+    // validate everything before the response is streamed
+    uint32_t digest = 0;
+    uint32_t bus_start_ticks = instrument_ticks();
+    ErrorCode code = eeprom_programmer.hash_range(0, page_size_bytes, HashAlgorithm::CRC32, digest);
+    stage_bus_io_usec += ticks_to_usec(instrument_ticks() - bus_start_ticks);
+    if (code == ErrorCode::SUCCESS && eeprom_programmer.get_memory_size_bytes() % page_size_bytes != 0) {
+      code = ErrorCode::INVALID_PAGE_SIZE;
+    }
+    if (code != ErrorCode::SUCCESS) {
+      rpc_board.send_error_P(request_id, -32023, PSTR("Service error"), PSTR("Failed to build CRC table for page size %lu with error: %d"), (unsigned long)page_size_bytes, code);
+      return;
+    }
+
+    // one CRC32 per page, streamed since 512 pages do not fit a JSON document; a delta write
+    // skips the pages that match, a CRC16 collision once in 65536 pages is too likely
+    const uint32_t pages_total = eeprom_programmer.get_memory_size_bytes() / page_size_bytes;
+    rpc_board.begin_result_array(request_id);
+    rpc_board.add_result_array_int(digest);
+    for (uint32_t page_no = 1; page_no < pages_total; page_no++) {
+      bus_start_ticks = instrument_ticks();
+      code = eeprom_programmer.hash_range(page_no * page_size_bytes, page_size_bytes, HashAlgorithm::CRC32, digest);
+      stage_bus_io_usec += ticks_to_usec(instrument_ticks() - bus_start_ticks);
+      if (code != ErrorCode::SUCCESS) {
+        // the client detects the short table
+        break;
+      }
+      rpc_board.add_result_array_int(digest);
+    }
+    rpc_board.end_result_array();
+
+  } else if (is_method(method, PSTR("set_write_mode"))) {
     if (params_size != 1) {
-      rpc_board.send_error(request_id, -32602, "Invalid params", "expected: (write_page_size_bytes)");
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (write_page_size_bytes)"));
       return;
     }
-    const int write_page_size_bytes = atoi(params[0].c_str());
+    const int write_page_size_bytes = params[0].as<int>();
 
     ErrorCode code = eeprom_programmer.set_write_mode(write_page_size_bytes);
     if (code != ErrorCode::SUCCESS) {
-      const size_t error_data_buf_size = 70;
-      char error_data_buf[error_data_buf_size];
-      snprintf(error_data_buf, error_data_buf_size, "Failed to set WRITE mode for page size %d with error: %d", write_page_size_bytes, code);
-      rpc_board.send_error(request_id, -32030, "Service error", error_data_buf);
+      rpc_board.send_error_P(request_id, -32030, PSTR("Service error"), PSTR("Failed to set WRITE mode for page size %d with error: %d"), write_page_size_bytes, code);
       return;
     }
 
-    const size_t result_buf_size = 50;
-    char result_buf[result_buf_size];
-    snprintf(result_buf, result_buf_size, "WRITE mode is ON for %d bytes pages", write_page_size_bytes);
-    rpc_board.send_result_string(request_id, result_buf);
+    rpc_board.send_result_string_P(request_id, PSTR("WRITE mode is ON for %d bytes pages"), write_page_size_bytes);
 
-  } else if (method == "write_page") {
+  } else if (is_method(method, PSTR("write_page"))) {
     if (params_size != 2) {
-      rpc_board.send_error(request_id, -32602, "Invalid params", "expected: (page_no, bytes_to_write)");
+      rpc_board.send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("expected: (page_no, bytes_to_write)"));
       return;
     }
-    const int page_no = atoi(params[0].c_str());
+    const int page_no = params[0].as<int>();
 
+    // the bytes come straight from the parsed request, no second document
     const size_t page_size = eeprom_programmer.get_page_size_bytes();
     uint8_t buffer[page_size];
-    const size_t json_array_size = SerialJsonRpcBoard::json_array_to_byte_array(params[1], buffer, page_size);
+    const size_t json_array_size = SerialJsonRpcBoard::json_array_to_byte_array(params[1].as<JsonArray>(), buffer, page_size);
 
-    ErrorCode code = eeprom_programmer.write_page(page_no, buffer, json_array_size);
+    // a pipelined page waits for the one in progress, checked now: the page size or more
+    if (write_request_pending) {
+      ErrorCode code = write_queued ? ErrorCode::WRITE_IN_PROGRESS : eeprom_programmer.check_write_page(page_no, json_array_size);
+      if (code != ErrorCode::SUCCESS) {
+        rpc_board.send_error_P(request_id, -32031, PSTR("Service error"), PSTR("Failed to WRITE page %d with error: %d"), page_no, code);
+        return;
+      }
+      memcpy(write_queued_bytes, buffer, json_array_size);
+      write_queued = true;
+      write_queued_id = request_id;
+      write_queued_page_no = page_no;
+      write_queued_size = json_array_size;
+      return;
+    }
+    begin_write_request(request_id, page_no, buffer, json_array_size);
+
+  } else if (is_method(method, PSTR("get_write_status"))) {
+    // [state, start_address, bytes_done, bytes_total, elapsed_usec, result]
+    // the state of the page write (WriteState), the result of the last page
+    int32_t result[] = {
+      eeprom_programmer.get_write_state(),
+      (int32_t)eeprom_programmer.get_write_start_address(),
+      (int32_t)eeprom_programmer.get_write_bytes_done(),
+      (int32_t)eeprom_programmer.get_write_bytes_total(),
+      write_request_pending ? (int32_t)ticks_to_usec(instrument_ticks() - write_request_start_ticks) : 0,
+      eeprom_programmer.get_write_result(),
+    };
+    rpc_board.send_result_ints(request_id, result, sizeof(result) / sizeof(result[0]));
+
+  } else if (is_method(method, PSTR("cancel_write"))) {
+    // the pending `write_page` ends with WRITE_CANCELLED after the byte in its write cycle,
+    // the held one does not start
+    ErrorCode code = eeprom_programmer.cancel_write();
     if (code != ErrorCode::SUCCESS) {
-      const size_t error_data_buf_size = 70;
-      char error_data_buf[error_data_buf_size];
-      snprintf(error_data_buf, error_data_buf_size, "Failed to WRITE page %d with error: %d", page_no, code);
-      rpc_board.send_error(request_id, -32031, "Service error", error_data_buf);
+      rpc_board.send_error_P(request_id, -32032, PSTR("Service error"), PSTR("Failed to cancel WRITE with error: %d"), code);
       return;
     }
 
-    const size_t result_buf_size = 50;
-    char result_buf[result_buf_size];
-    snprintf(result_buf, result_buf_size, "WRITE success. %d bytes written", json_array_size);
-    rpc_board.send_result_string(request_id, result_buf);
+    rpc_board.send_result_string_P(request_id, PSTR("WRITE cancel requested at byte %d"), (int)eeprom_programmer.get_write_bytes_done());
+    drop_queued_write();
 
-  } else if (method == "get_write_perf") {
+  } else if (is_method(method, PSTR("get_write_perf"))) {
+    // unsigned long is not int32_t on every target
     const size_t page_size = eeprom_programmer.get_page_size_bytes();
-    unsigned long wait_time_for_page[page_size];
-    eeprom_programmer.get_write_op_wait_time_usec_for_page(wait_time_for_page, page_size);
+    rpc_board.begin_result_array(request_id);
+    for (size_t i = 0; i < page_size; i++) {
+      rpc_board.add_result_array_int((int32_t)eeprom_programmer.get_write_op_wait_time_usec_for_page(i));
+    }
+    rpc_board.end_result_array();
+
+  } else if (is_method(method, PSTR("get_stage_times"))) {
+    // usec since the last reset, the client splits the operation time with them
+    int32_t result[] = {
+      (int32_t)rpc_board.get_requests_count(),
+      (int32_t)rpc_board.get_parse_time_usec(),
+      (int32_t)stage_bus_io_usec,
+      (int32_t)stage_write_wait_usec,
+      (int32_t)rpc_board.get_send_time_usec(),
+    };
+    rpc_board.send_result_ints(request_id, result, sizeof(result) / sizeof(result[0]));
+
+  } else if (is_method(method, PSTR("reset_stage_times"))) {
+    rpc_board.reset_stage_times();
+    stage_bus_io_usec = 0;
+    stage_write_wait_usec = 0;
+    rpc_board.send_result_string_P(request_id, PSTR("Stage times reset"));
+
+  } else if (is_method(method, PSTR("get_link_stats"))) {
+    // since the last reset, the bytes of this response are not counted yet
+    int32_t result[] = {
+      (int32_t)rpc_board.get_bytes_received(),
+      (int32_t)rpc_board.get_bytes_sent(),
+      (int32_t)rpc_board.get_frames(),
+      (int32_t)rpc_board.get_parse_errors(),
+      (int32_t)rpc_board.get_overflows(),
+      (int32_t)rpc_board.get_flush_time_usec(),
+    };
+    rpc_board.send_result_ints(request_id, result, sizeof(result) / sizeof(result[0]));
+
+  } else if (is_method(method, PSTR("reset_link_stats"))) {
+    rpc_board.reset_link_stats();
+    rpc_board.send_result_string_P(request_id, PSTR("Link stats reset"));
 
-    rpc_board.send_result_ints(request_id, wait_time_for_page, page_size);
+  } else if (is_method(method, PSTR("get_stats"))) {
+    // [histograms, buckets, then per histogram: count, min, max, sum, buckets...]
+    // write-cycle wait per byte, bus read per page, request parse, response send; usec
+    // streamed, since 144 numbers do not fit a JSON document in SRAM
+    rpc_board.begin_result_array(request_id);
+    rpc_board.add_result_array_int(4);
+    rpc_board.add_result_array_int(LatencyHistogram::BUCKETS);
+    add_histogram_to_result(eeprom_programmer.get_write_wait_histogram());
+    add_histogram_to_result(bus_read_page_histogram);
+    add_histogram_to_result(rpc_board.get_parse_histogram());
+    add_histogram_to_result(rpc_board.get_send_histogram());
+    rpc_board.end_result_array();
+
+  } else if (is_method(method, PSTR("reset_stats"))) {
+    eeprom_programmer.get_write_wait_histogram().reset();
+    bus_read_page_histogram.reset();
+    rpc_board.get_parse_histogram().reset();
+    rpc_board.get_send_histogram().reset();
+    rpc_board.send_result_string_P(request_id, PSTR("Stats reset"));
+
+  } else if (is_method(method, PSTR("dump_trace"))) {
+    // [depth, dropped, then per record: event, micros, arg], oldest first
+    // drains the records present now, the response adds its own send events for the next dump
+    // a firmware without the trace answers with the depth 0
+    rpc_board.begin_result_array(request_id);
+#if STAGE_TRACE_DEPTH > 0
+    uint16_t records = stage_trace.size();
+    rpc_board.add_result_array_int(StageTrace::DEPTH);
+    rpc_board.add_result_array_int((int32_t)stage_trace.get_dropped());
+    stage_trace.reset_dropped();
+    TraceRecord record;
+    while (records-- > 0 && stage_trace.pop(record)) {
+      rpc_board.add_result_array_int(record.event);
+      rpc_board.add_result_array_int((int32_t)record.micros_usec);
+      rpc_board.add_result_array_int((int32_t)record.arg);
+    }
+#else
+    rpc_board.add_result_array_int(0);
+    rpc_board.add_result_array_int(0);
+#endif
+    rpc_board.end_result_array();
+
+  } else if (is_method(method, PSTR("get_memory"))) {
+    // bytes: static data, free heap, largest free block, stack peak and headroom since the paint,
+    // then the request peaks since the last reset: document capacity and usage, message length
+    // the host build has no AVR heap and stack, its SRAM figures are MEMORY_UNSUPPORTED (-1)
+    int32_t result[] = {
+      (int32_t)get_static_bytes(),
+      (int32_t)get_free_heap_bytes(),
+      (int32_t)get_largest_free_block_bytes(),
+      (int32_t)get_stack_peak_bytes(),
+      (int32_t)get_stack_headroom_bytes(),
+      (int32_t)rpc_board.get_request_doc_peak_capacity(),
+      (int32_t)rpc_board.get_request_doc_peak_usage(),
+      (int32_t)rpc_board.get_message_peak_bytes(),
+    };
+    rpc_board.send_result_ints(request_id, result, sizeof(result) / sizeof(result[0]));
+
+  } else if (is_method(method, PSTR("reset_memory"))) {
+    rpc_board.reset_memory_peaks();
+    repaint_stack();
+    rpc_board.send_result_string_P(request_id, PSTR("Memory peaks reset"));
 
   } else {
-    rpc_board.send_error(request_id, -32601, "Method not found", method.c_str());
+    rpc_board.send_error(request_id, -32601, PSTR("Method not found"), method);
+  }
+}
+
+
+// Write
+
+// one state of the page write per loop, the `write_page` response goes out when the page ends
+// and the queued page starts; the bus time includes the requests served in between, the
+// write-cycle wait does not
+static void write_loop() {
+  if (!write_request_pending) {
+    return;
+  }
+  ErrorCode code = eeprom_programmer.write_step();
+  if (code == ErrorCode::WRITE_IN_PROGRESS) {
+    return;
+  }
+  write_request_pending = false;
+
+  const unsigned long write_wait_usec = eeprom_programmer.get_write_op_wait_time_usec_page_total();
+  stage_bus_io_usec += ticks_to_usec(instrument_ticks() - write_request_start_ticks) - write_wait_usec;
+  stage_write_wait_usec += write_wait_usec;
+  if (code != ErrorCode::SUCCESS) {
+    rpc_board.send_error_P(write_request_id, -32031, PSTR("Service error"), PSTR("Failed to WRITE page %d with error: %d"), write_request_page_no, code);
+  } else {
+    rpc_board.send_result_string_P(write_request_id, PSTR("WRITE success. %d bytes written"), (int)eeprom_programmer.get_write_bytes_total());
+  }
+
+  if (write_queued) {
+    write_queued = false;
+    begin_write_request(write_queued_id, write_queued_page_no, write_queued_bytes, write_queued_size);
   }
 }
 
@@ -151,4 +444,5 @@ void setup() {
 
 void loop() {
   rpc_board.loop();
+  write_loop();
 }
@@ -3,9 +3,20 @@
 #ifndef __eeprom_programmer_lib_h__
 #define __eeprom_programmer_lib_h__
 
+#include <SPI.h>
+
+#include "bus_timing.h"
 #include "eeprom_programmer_wiring.h"
+#include "instrument_clock.h"
+#include "latency_histogram.h"
+#include "pin_edge.h"
+#include "stage_trace.h"
 
+using namespace BusTimingLibrary;
 using namespace EepromProgrammerWiring;
+using namespace InstrumentClockLibrary;
+using namespace LatencyHistogramLibrary;
+using namespace PinEdgeLibrary;
 
 namespace EepromProgrammerLibrary {
 
@@ -30,20 +41,75 @@ enum ErrorCode : int {
   // write
   WRITE_MODE_DISABLED = 51,
   WRITE_FAILED = 52,
+  WRITE_NOT_SUPPORTED = 53,
+  WRITE_IN_PROGRESS = 54,
+  WRITE_CANCELLED = 55,
+  WRITE_NOT_IN_PROGRESS = 56,
+  // hash
+  HASH_NOT_SUPPORTED = 61,
   // unknown
   UNKNOWN_ERROR = 1000
 };
 
 
+// Range Hash
+
+enum HashAlgorithm : int {
+  CRC32 = 1,  // IEEE 802.3, the same as zlib.crc32
+  SUM8 = 2,   // classic 8-bit ROM checksum
+  SUM16 = 3,  // classic 16-bit ROM checksum
+  CRC16 = 4,  // CCITT-FALSE, the same as binascii.crc_hqx(data, 0xFFFF)
+  UNKNOWN_HASH = 1000
+};
+
+HashAlgorithm str_to_hash_algorithm(const char* algorithm) {
+  if (strcasecmp_P(algorithm, PSTR("CRC32")) == 0) {
+    return HashAlgorithm::CRC32;
+  } else if (strcasecmp_P(algorithm, PSTR("SUM8")) == 0) {
+    return HashAlgorithm::SUM8;
+  } else if (strcasecmp_P(algorithm, PSTR("SUM16")) == 0) {
+    return HashAlgorithm::SUM16;
+  } else if (strcasecmp_P(algorithm, PSTR("CRC16")) == 0) {
+    return HashAlgorithm::CRC16;
+  }
+  return HashAlgorithm::UNKNOWN_HASH;
+}
+
+
+// Write State Machine
+// one byte of a page goes through the states in order, `write_step` runs one state per call
+// keep the values stable, `get_write_status` reports them
+
+enum WriteState : uint8_t {
+  WRITE_IDLE = 0,
+  WRITE_LOAD = 1,    // address and data on the bus
+  WRITE_PULSE = 2,   // !CE low, !WE pulse, the write cycle starts on the rising edge
+  WRITE_POLL = 3,    // one completion check: RDY/!BUSY, DATA polling or the fixed delay
+  WRITE_VERIFY = 4,  // read the byte back, unless the completion check saw the data or the RDY edge
+  WRITE_NEXT = 5,    // write-cycle stats of the byte, then the next byte or the end of the page
+};
+
+// how the end of the write cycle is timed, the write-cycle wait figures depend on it
+// keep the values stable, `init_chip` reports them
+enum WriteTiming : uint8_t {
+  TIMING_POLLED = 0,     // the poll that noticed the end: 100 us slack with RDY/!BUSY
+  TIMING_INTERRUPT = 1,  // the interrupt of the RDY/!BUSY edge read the clock
+  TIMING_CAPTURE = 2,    // the timer latched the RDY/!BUSY edge in hardware
+};
+
+
 // EEPROM Programmer
 
 class EepromProgrammer {
 public:
+  // the largest page of a read or write request
+  static const uint32_t MAX_PAGE_SIZE = 128;
+
   EepromProgrammer(const WiringType wiring_type);
 
   // init
   ErrorCode init_programmer();
-  ErrorCode init_chip(const String& chip_type);
+  ErrorCode init_chip(const char* chip_type);
 
   // settings
   inline uint32_t get_memory_size_bytes() {
@@ -55,41 +121,92 @@ public:
   inline uint32_t get_max_page_size() {
     return _MAX_PAGE_SIZE;
   }
+  // valid after `init_chip`
+  inline const ChipDescriptor& get_chip_descriptor() {
+    return _wiring_controller.get_chip_descriptor();
+  }
 
   // read
   ErrorCode set_read_mode(const uint32_t page_size_bytes);
   ErrorCode read_page(const int page_no, uint8_t* bytes);
   ErrorCode read_byte(const uint32_t address, uint8_t& byte);
+  ErrorCode hash_range(const uint32_t start_address, const uint32_t length, const HashAlgorithm algorithm, uint32_t& digest);
 
   // write
   ErrorCode set_write_mode(const uint32_t page_size_bytes);
+  // blocking, run the write state machine to the end
   ErrorCode write_page(const int page_no, const uint8_t* bytes, const size_t bytes_size);
   ErrorCode write_byte(const uint32_t address, const uint8_t data);
 
+  // non-blocking page write: `begin_write_page` copies the bytes and returns, then every
+  // `write_step` runs one state and returns WRITE_IN_PROGRESS until the page ends with its result
+  // a step blocks for one poll interval at most (100 us), the bus calls return WRITE_IN_PROGRESS
+  // until the page ends
+  ErrorCode begin_write_page(const int page_no, const uint8_t* bytes, const size_t bytes_size);
+  // the checks of `begin_write_page` but the busy one, for a page held until the current one ends
+  ErrorCode check_write_page(const int page_no, const size_t bytes_size);
+  ErrorCode write_step();
+  // the byte in its write cycle completes, then the page ends with WRITE_CANCELLED
+  ErrorCode cancel_write();
+
+  bool is_write_busy() {
+    return _write_state != WriteState::WRITE_IDLE;
+  }
+  WriteState get_write_state() {
+    return _write_state;
+  }
+  uint32_t get_write_start_address() {
+    return _write_start_address;
+  }
+  // bytes through the NEXT state of the current page, or of the last one
+  size_t get_write_bytes_done() {
+    return _write_pos;
+  }
+  size_t get_write_bytes_total() {
+    return _write_bytes_total;
+  }
+  // the result of the last page, SUCCESS before the first one
+  ErrorCode get_write_result() {
+    return _write_result;
+  }
+  // the timing of the write-cycle waits of the initialized chip
+  WriteTiming get_write_timing() {
+    if (_write_completion != WriteCompletion::RDY_BUSY || !_rdy_busy_interrupt) {
+      return WriteTiming::TIMING_POLLED;
+    }
+    return rising_edge.is_captured() ? WriteTiming::TIMING_CAPTURE : WriteTiming::TIMING_INTERRUPT;
+  }
+
   // debugging
   unsigned long get_write_op_wait_time_usec() {
     return _write_op_wait_time_usec;
   }
 
-  void get_write_op_wait_time_usec_for_page(unsigned long* wait_time_for_page, const size_t buffer_size) {
-    if (buffer_size <= 0 || buffer_size > _MAX_PAGE_SIZE) {
-      return;
-    }
-    for (int i; i < buffer_size; i++) {
-      wait_time_for_page[i] = _write_op_wait_time_usec_for_page[i];
-    }
+  // write-cycle wait of the byte `i` of the last page
+  unsigned long get_write_op_wait_time_usec_for_page(const size_t i) {
+    return i < _MAX_PAGE_SIZE ? _write_op_wait_time_usec_for_page[i] : 0;
+  }
+
+  // sum of the write-cycle waits of the last page, summed in ticks
+  unsigned long get_write_op_wait_time_usec_page_total() {
+    return ticks_to_usec(_write_op_wait_ticks_page_total);
   }
 
   int get_write_op_wait_cycles() {
     return _write_op_wait_cycles;
   }
 
+  // write-cycle wait of every byte since the last reset
+  LatencyHistogram& get_write_wait_histogram() {
+    return _write_wait_histogram;
+  }
+
   // helpers
   static String address_to_binary_string(const uint32_t address, const size_t address_bus_size) {
     bool b_address[address_bus_size];
     _addressToBitsArray(address, b_address, address_bus_size);
     String result = "";
-    for (int i = 0; i < address_bus_size; i++) {
+    for (size_t i = 0; i < address_bus_size; i++) {
       // print in reverse order, since the printed A0 should be the last bit
       result += b_address[address_bus_size - 1 - i] ? 1 : 0;
     }
@@ -109,13 +226,19 @@ public:
   }
 
 private:
-  static const uint32_t _MAX_PAGE_SIZE = 64;
+  // the SRAM of the flash-resident tables and literals goes to 128 byte pages
+  static const uint32_t _MAX_PAGE_SIZE = MAX_PAGE_SIZE;
+
+  // the write-cycle polling gives up after this many max write-cycle times (tWC) of the chip
+  // AT28C64 write time is about 400 us, 1 ms max
+  // AT28C256 write time is about 6000 us, 10 ms max
+  static const unsigned int _WRITE_TIMEOUT_WRITE_CYCLES = 2;
+
+  // 74HC595 shift clock max is ~25 MHz at 4.5 V, the hardware SPI of the Mega tops out at F_CPU / 2
+  static const uint32_t _SHIFT_SPI_CLOCK_HZ = 8000000;
 
-  // tune this constant if write is not working
-  // if the waiting is insufficient, data propagation may be incomplete
-  // AT28C64 write time is about 400 us
-  // AT28C256 write time is about 6000 us
-  static const unsigned int _WRITE_SUCCESS_WAITING_TIME_USEC = int(20.0 * 1000);
+  // Time to Device Busy (tDB), !WE high to RDY/!BUSY low: 50 ns max
+  static constexpr uint8_t _DEVICE_BUSY_DELAY_LOOPS = nsec_to_loops(50);
 
   enum _DataBusMode {
     READ,
@@ -124,11 +247,15 @@ private:
   void _setAddressBusMode();
   void _setDataBusMode(const _DataBusMode mode);
   void _writeAddress(const uint32_t address);
+  void _shiftAddress(const uint32_t address);
+  void _pulseLatch(const PIN_NO latch_pin);
   uint8_t _readData();
   void _writeData(const uint8_t data);
 
-  void _rdy_busy_polling(const unsigned long write_op_start_usec, const uint8_t data);
-  void _data_polling(const unsigned long write_op_start_usec, const uint8_t data);
+  void _begin_write(const uint32_t start_address, const uint8_t* bytes, const size_t bytes_size);
+  ErrorCode _end_write(const ErrorCode code);
+  bool _write_poll(const uint8_t data);
+  uint8_t _read_back(const uint32_t address);
 
   // wiring controller
   WiringController _wiring_controller;
@@ -137,6 +264,14 @@ private:
   // address bus
   PIN_NO _address_bus_pins[WiringController::MAX_ADDRESS_BUS_SIZE];
   size_t _address_bus_size;
+  // shift-register address bits, the leading `_shift_address_size` pins of the address bus are 0
+  size_t _shift_address_size;
+  PIN_NO _shift_latch_low_pin;
+  PIN_NO _shift_latch_high_pin;
+  // the latched register outputs, a byte is shifted again only when it changes
+  uint8_t _shift_low_byte;
+  uint8_t _shift_high_byte;
+  bool _shift_latched;
   // data bus
   PIN_NO _data_bus_pins[WiringController::MAX_DATA_BUS_SIZE];
   size_t _data_bus_size;
@@ -145,6 +280,8 @@ private:
   PIN_NO _output_enable_pin;  // !OE
   PIN_NO _write_enable_pin;   // !WE
   PIN_NO _rdy_busy_pin;       // RDY / !BUSY
+  // the pin has an interrupt, `rising_edge` times the end of the write cycle
+  bool _rdy_busy_interrupt;
 
   // inner
   bool _pins_initialized;
@@ -156,9 +293,35 @@ private:
   bool _read_mode;
   bool _write_mode;
 
+  // timing, from the chip descriptor
+  unsigned int _write_cycle_max_usec;
+  unsigned int _write_timeout_usec;
+  uint8_t _output_delay_loops;
+  uint8_t _write_pulse_loops;
+  WriteCompletion _write_completion;
+
+  // write state machine
+  WriteState _write_state;
+  uint8_t _write_buffer[_MAX_PAGE_SIZE];
+  uint32_t _write_start_address;
+  size_t _write_bytes_total;
+  size_t _write_pos;
+  bool _write_cancel;
+  ErrorCode _write_result;
+  // the completion check of the byte: the chip setting, FIXED_DELAY when RDY/!BUSY never went low
+  WriteCompletion _write_poll_completion;
+  // the completion check saw the written data or the RDY edge, VERIFY skips the read back
+  bool _write_confirmed;
+  // instrument clock ticks of the rising edge of !WE
+  uint32_t _write_op_start_ticks;
+  uint32_t _write_op_wait_ticks;
+
   // debugging
   unsigned long _write_op_wait_time_usec;
-  unsigned long _write_op_wait_time_usec_for_page[_MAX_PAGE_SIZE];
+  // the wait stops at the write timeout, 2 tWC of 10 ms fits 16 bits
+  uint16_t _write_op_wait_time_usec_for_page[_MAX_PAGE_SIZE];
+  uint32_t _write_op_wait_ticks_page_total;
+  LatencyHistogram _write_wait_histogram;
   int _write_op_wait_cycles;
 
   // bit operations
@@ -172,7 +335,7 @@ private:
     if (address >= memory_size_bytes) {
       return;
     }
-    for (int i = 0; i < address_bus_size; ++i) {
+    for (size_t i = 0; i < address_bus_size; ++i) {
       // MSB order
       // b_address[address_bus_size - 1 - i] = (address >> i) & 1;
       // LSB order
@@ -182,7 +345,7 @@ private:
 
   static void _dataToBitsArray(uint8_t data, bool* b_data, const size_t data_bus_size) {
     // MSB order
-    for (int i = 0; i < data_bus_size; i++) {
+    for (size_t i = 0; i < data_bus_size; i++) {
       // MSP order
       // b_data[data_bus_size - 1 - i] = bitRead(data, i);
       // LSB order
@@ -190,10 +353,27 @@ private:
     }
   }
 
+  // bitwise CRC32, a 1 KB lookup table does not fit the SRAM budget
+  static uint32_t _crc32Update(uint32_t crc, const uint8_t data) {
+    crc ^= data;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1)));
+    }
+    return crc;
+  }
+
+  static uint16_t _crc16Update(uint16_t crc, const uint8_t data) {
+    crc ^= (uint16_t)data << 8;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+  }
+
   static uint8_t _bitsArrayToData(const bool* b_data, const size_t data_bus_size) {
     // MSB order
     uint8_t data = 0;
-    for (int i = 0; i < data_bus_size; i++) {
+    for (size_t i = 0; i < data_bus_size; i++) {
       data = (data << 1) | b_data[data_bus_size - 1 - i];
     }
     return data;
@@ -209,6 +389,12 @@ EepromProgrammer::EepromProgrammer(const WiringType wiring_type)
 
   // pins
   _address_bus_size = 0;
+  _shift_address_size = 0;
+  _shift_latch_low_pin = 0;
+  _shift_latch_high_pin = 0;
+  _shift_low_byte = 0;
+  _shift_high_byte = 0;
+  _shift_latched = false;
   _data_bus_size = 0;
 
   // mode
@@ -217,15 +403,39 @@ EepromProgrammer::EepromProgrammer(const WiringType wiring_type)
   _read_mode = false;
   _write_mode = false;
 
+  // timing
+  _write_cycle_max_usec = 0;
+  _write_timeout_usec = 0;
+  _output_delay_loops = nsec_to_loops(1000);
+  _write_pulse_loops = 0;
+  _write_completion = WriteCompletion::FIXED_DELAY;
+
   // performance
   _write_op_wait_time_usec = 0;
-  for (int i = 0; i < _MAX_PAGE_SIZE; i++) {
+  for (uint32_t i = 0; i < _MAX_PAGE_SIZE; i++) {
     _write_op_wait_time_usec_for_page[i] = 0;
   }
+  _write_op_wait_ticks_page_total = 0;
   _write_op_wait_cycles = -1;
+
+  // write state machine
+  _write_state = WriteState::WRITE_IDLE;
+  _write_start_address = 0;
+  _write_bytes_total = 0;
+  _write_pos = 0;
+  _write_cancel = false;
+  _write_result = ErrorCode::SUCCESS;
+  _write_poll_completion = WriteCompletion::FIXED_DELAY;
+  _write_confirmed = false;
+  _rdy_busy_interrupt = false;
+  _write_op_start_ticks = 0;
+  _write_op_wait_ticks = 0;
 }
 
 ErrorCode EepromProgrammer::init_programmer() {
+  // the clock of the write timing stats
+  begin_instrument_clock();
+
   PIN_NO board_bus_pins[WiringController::MAX_BOARD_BUS_SIZE];
   const size_t board_bus_size = _wiring_controller.get_board_bus_pins(board_bus_pins, WiringController::MAX_BOARD_BUS_SIZE);
   if (board_bus_size <= 0) {
@@ -248,7 +458,7 @@ ErrorCode EepromProgrammer::init_programmer() {
   return ErrorCode::SUCCESS;
 }
 
-ErrorCode EepromProgrammer::init_chip(const String& chip_type) {
+ErrorCode EepromProgrammer::init_chip(const char* chip_type) {
   if (!_pins_initialized) {
     return ErrorCode::PINS_NOT_INITIALIZED;
   }
@@ -268,6 +478,20 @@ ErrorCode EepromProgrammer::init_chip(const String& chip_type) {
   }
   _memory_size_bytes = (uint32_t)(1) << _address_bus_size;
 
+  // shift-register address bits
+  _shift_address_size = _wiring_controller.get_shift_address_size();
+  if (_shift_address_size > 0) {
+    _wiring_controller.get_shift_latch_pins(_shift_latch_low_pin, _shift_latch_high_pin);
+    pinMode(_shift_latch_low_pin, OUTPUT);
+    digitalWrite(_shift_latch_low_pin, LOW);
+    pinMode(_shift_latch_high_pin, OUTPUT);
+    digitalWrite(_shift_latch_high_pin, LOW);
+    // the registers are the only device on the bus, the transaction stays open
+    SPI.begin();
+    SPI.beginTransaction(SPISettings(_SHIFT_SPI_CLOCK_HZ, MSBFIRST, SPI_MODE0));
+    _shift_latched = false;
+  }
+
   _setAddressBusMode();
   // reset address
   _writeAddress(0);
@@ -305,6 +529,25 @@ ErrorCode EepromProgrammer::init_chip(const String& chip_type) {
   if (_rdy_busy_pin > 0) {
     // open drain
     pinMode(_rdy_busy_pin, INPUT_PULLUP);
+    // polled when the pin has no ICP, INT or PCINT, or the wiring uses it for another line too
+    PIN_NO wired_pins[WiringController::MAX_WIRED_PINS];
+    size_t wired_size = _wiring_controller.get_other_wired_pins(_rdy_busy_pin, wired_pins, WiringController::MAX_WIRED_PINS);
+    if (wired_size == (size_t)-1) {
+      wired_size = 0;
+    }
+    _rdy_busy_interrupt = rising_edge.attach(_rdy_busy_pin, wired_pins, wired_size);
+  }
+
+  // timing
+  const ChipDescriptor& chip = _wiring_controller.get_chip_descriptor();
+  _write_cycle_max_usec = chip.write_cycle_max_usec;
+  _write_timeout_usec = _WRITE_TIMEOUT_WRITE_CYCLES * chip.write_cycle_max_usec;
+  // the delay loops of the read and write strobes, computed from F_CPU by the compiler
+  _output_delay_loops = chip.bus_timing.output_delay_loops;
+  _write_pulse_loops = chip.bus_timing.write_pulse_loops;
+  _write_completion = chip.write_completion;
+  if (_write_completion == WriteCompletion::RDY_BUSY && _rdy_busy_pin == 0) {
+    _write_completion = WriteCompletion::DATA_POLLING;
   }
 
   _chip_ready = true;
@@ -319,6 +562,9 @@ ErrorCode EepromProgrammer::set_read_mode(const uint32_t page_size_bytes) {
   if (!_chip_ready) {
     return ErrorCode::CHIP_NOT_INITIALIZED;
   }
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
+  }
   if (page_size_bytes < 1 || page_size_bytes > _MAX_PAGE_SIZE) {
     return ErrorCode::INVALID_PAGE_SIZE;
   }
@@ -345,20 +591,26 @@ ErrorCode EepromProgrammer::read_page(const int page_no, uint8_t* bytes) {
   if (!_read_mode) {
     return ErrorCode::READ_MODE_DISABLED;
   }
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
+  }
   const uint32_t max_page_no = _memory_size_bytes / _page_size_bytes;
-  if (page_no < 0 || page_no >= max_page_no) {
+  if (page_no < 0 || (uint32_t)page_no >= max_page_no) {
     return ErrorCode::INVALID_PAGE_NO;
   }
 
+  STAGE_TRACE(READ_PAGE_BEGIN, page_no);
   const uint32_t start_address = page_no * _page_size_bytes;
-  for (int i = 0; i < _page_size_bytes; i++) {
+  for (uint32_t i = 0; i < _page_size_bytes; i++) {
     uint8_t byte = -1;
     ErrorCode code = read_byte(start_address + i, byte);
     if (code != ErrorCode::SUCCESS) {
+      STAGE_TRACE(READ_PAGE_END, ErrorCode::READ_FAILED);
       return ErrorCode::READ_FAILED;
     }
     bytes[i] = byte;
   }
+  STAGE_TRACE(READ_PAGE_END, ErrorCode::SUCCESS);
 
   return ErrorCode::SUCCESS;
 }
@@ -373,7 +625,10 @@ ErrorCode EepromProgrammer::read_byte(const uint32_t address, uint8_t& byte) {
   if (!_read_mode) {
     return ErrorCode::READ_MODE_DISABLED;
   }
-  if (address < 0 || address >= _memory_size_bytes) {
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
+  }
+  if (address >= _memory_size_bytes) {
     return ErrorCode::INVALID_ADDRESS;
   }
 
@@ -386,8 +641,8 @@ ErrorCode EepromProgrammer::read_byte(const uint32_t address, uint8_t& byte) {
   // (3) output enable
   digitalWrite(_output_enable_pin, LOW);
 
-  // (4) !OE to Output Delay (delta between OE and data ready) == 100 ns MAX
-  delayMicroseconds(1);  // arduino cannot delay in ns, only us
+  // (4) address to output (tACC) and !OE to output (tOE) delays of the chip
+  delay_loops(_output_delay_loops);
 
   // (5) read data
   byte = _readData();
@@ -401,6 +656,68 @@ ErrorCode EepromProgrammer::read_byte(const uint32_t address, uint8_t& byte) {
   return ErrorCode::SUCCESS;
 }
 
+ErrorCode EepromProgrammer::hash_range(const uint32_t start_address, const uint32_t length, const HashAlgorithm algorithm, uint32_t& digest) {
+  if (!_pins_initialized) {
+    return ErrorCode::PINS_NOT_INITIALIZED;
+  }
+  if (!_chip_ready) {
+    return ErrorCode::CHIP_NOT_INITIALIZED;
+  }
+  if (!_read_mode) {
+    return ErrorCode::READ_MODE_DISABLED;
+  }
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
+  }
+  if (length < 1 || start_address >= _memory_size_bytes || length > _memory_size_bytes - start_address) {
+    return ErrorCode::INVALID_ADDRESS;
+  }
+  if (algorithm == HashAlgorithm::UNKNOWN_HASH) {
+    return ErrorCode::HASH_NOT_SUPPORTED;
+  }
+
+  STAGE_TRACE(HASH_BEGIN, length);
+  uint32_t hash = 0;
+  if (algorithm == HashAlgorithm::CRC32) {
+    hash = 0xFFFFFFFFUL;
+  } else if (algorithm == HashAlgorithm::CRC16) {
+    hash = 0xFFFF;
+  }
+  for (uint32_t address = start_address; address < start_address + length; address++) {
+    uint8_t byte = -1;
+    ErrorCode code = read_byte(address, byte);
+    if (code != ErrorCode::SUCCESS) {
+      STAGE_TRACE(HASH_END, ErrorCode::READ_FAILED);
+      return ErrorCode::READ_FAILED;
+    }
+    if (algorithm == HashAlgorithm::CRC32) {
+      hash = _crc32Update(hash, byte);
+    } else if (algorithm == HashAlgorithm::CRC16) {
+      hash = _crc16Update(hash, byte);
+    } else {
+      hash += byte;
+    }
+  }
+
+  switch (algorithm) {
+    case HashAlgorithm::CRC32:
+      digest = ~hash;
+      break;
+    case HashAlgorithm::SUM8:
+      digest = hash & 0xFF;
+      break;
+    case HashAlgorithm::SUM16:
+    case HashAlgorithm::CRC16:
+      digest = hash & 0xFFFF;
+      break;
+    default:
+      return ErrorCode::HASH_NOT_SUPPORTED;
+  }
+  STAGE_TRACE(HASH_END, ErrorCode::SUCCESS);
+
+  return ErrorCode::SUCCESS;
+}
+
 ErrorCode EepromProgrammer::set_write_mode(const uint32_t page_size_bytes) {
   if (!_pins_initialized) {
     return ErrorCode::PINS_NOT_INITIALIZED;
@@ -408,6 +725,12 @@ ErrorCode EepromProgrammer::set_write_mode(const uint32_t page_size_bytes) {
   if (!_chip_ready) {
     return ErrorCode::CHIP_NOT_INITIALIZED;
   }
+  if (_write_completion == WriteCompletion::READ_ONLY) {
+    return ErrorCode::WRITE_NOT_SUPPORTED;
+  }
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
+  }
   if (page_size_bytes < 1 || page_size_bytes > _MAX_PAGE_SIZE) {
     return ErrorCode::INVALID_PAGE_SIZE;
   }
@@ -426,6 +749,18 @@ ErrorCode EepromProgrammer::set_write_mode(const uint32_t page_size_bytes) {
 }
 
 ErrorCode EepromProgrammer::write_page(const int page_no, const uint8_t* bytes, const size_t bytes_size) {
+  ErrorCode code = begin_write_page(page_no, bytes, bytes_size);
+  if (code != ErrorCode::SUCCESS) {
+    return code;
+  }
+  code = ErrorCode::WRITE_IN_PROGRESS;
+  while (code == ErrorCode::WRITE_IN_PROGRESS) {
+    code = write_step();
+  }
+  return code;
+}
+
+ErrorCode EepromProgrammer::write_byte(const uint32_t address, const uint8_t data) {
   if (!_pins_initialized) {
     return ErrorCode::PINS_NOT_INITIALIZED;
   }
@@ -435,27 +770,37 @@ ErrorCode EepromProgrammer::write_page(const int page_no, const uint8_t* bytes,
   if (!_write_mode) {
     return ErrorCode::WRITE_MODE_DISABLED;
   }
-  if (bytes_size <= 0 || bytes_size > _page_size_bytes) {
-    return ErrorCode::INVALID_PAGE_SIZE;
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
   }
-  const uint32_t max_page_no = _memory_size_bytes / _page_size_bytes;
-  if (page_no < 0 || page_no >= max_page_no) {
-    return ErrorCode::INVALID_PAGE_NO;
+  if (address >= _memory_size_bytes) {
+    return ErrorCode::INVALID_ADDRESS;
   }
 
-  const uint32_t start_address = page_no * _page_size_bytes;
-  for (int i = 0; i < bytes_size; i++) {
-    ErrorCode code = write_byte(start_address + i, bytes[i]);
-    if (code != ErrorCode::SUCCESS) {
-      return ErrorCode::WRITE_FAILED;
-    }
-    _write_op_wait_time_usec_for_page[i] = _write_op_wait_time_usec;
+  _begin_write(address, &data, 1);
+  ErrorCode code = ErrorCode::WRITE_IN_PROGRESS;
+  while (code == ErrorCode::WRITE_IN_PROGRESS) {
+    code = write_step();
+  }
+  return code;
+}
+
+ErrorCode EepromProgrammer::begin_write_page(const int page_no, const uint8_t* bytes, const size_t bytes_size) {
+  if (is_write_busy()) {
+    return ErrorCode::WRITE_IN_PROGRESS;
+  }
+  ErrorCode code = check_write_page(page_no, bytes_size);
+  if (code != ErrorCode::SUCCESS) {
+    return code;
   }
 
+  STAGE_TRACE(WRITE_PAGE_BEGIN, page_no);
+  _begin_write(page_no * _page_size_bytes, bytes, bytes_size);
+
   return ErrorCode::SUCCESS;
 }
 
-ErrorCode EepromProgrammer::write_byte(const uint32_t address, const uint8_t data) {
+ErrorCode EepromProgrammer::check_write_page(const int page_no, const size_t bytes_size) {
   if (!_pins_initialized) {
     return ErrorCode::PINS_NOT_INITIALIZED;
   }
@@ -465,74 +810,186 @@ ErrorCode EepromProgrammer::write_byte(const uint32_t address, const uint8_t dat
   if (!_write_mode) {
     return ErrorCode::WRITE_MODE_DISABLED;
   }
-  if (address < 0 || address >= _memory_size_bytes) {
-    return ErrorCode::INVALID_ADDRESS;
+  if (bytes_size <= 0 || bytes_size > _page_size_bytes) {
+    return ErrorCode::INVALID_PAGE_SIZE;
+  }
+  const uint32_t max_page_no = _memory_size_bytes / _page_size_bytes;
+  if (page_no < 0 || (uint32_t)page_no >= max_page_no) {
+    return ErrorCode::INVALID_PAGE_NO;
   }
+  return ErrorCode::SUCCESS;
+}
 
-  // (1) set address
-  _writeAddress(address);
+// the bytes fit the buffer, `_page_size_bytes` is at most `_MAX_PAGE_SIZE`
+void EepromProgrammer::_begin_write(const uint32_t start_address, const uint8_t* bytes, const size_t bytes_size) {
+  memcpy(_write_buffer, bytes, bytes_size);
+  _write_start_address = start_address;
+  _write_bytes_total = bytes_size;
+  _write_pos = 0;
+  _write_cancel = false;
+  _write_op_wait_ticks_page_total = 0;
+  _write_state = WriteState::WRITE_LOAD;
+}
 
-  // (2) chip enable
-  digitalWrite(_chip_enable_pin, LOW);
+ErrorCode EepromProgrammer::cancel_write() {
+  if (!is_write_busy()) {
+    return ErrorCode::WRITE_NOT_IN_PROGRESS;
+  }
+  _write_cancel = true;
+  return ErrorCode::SUCCESS;
+}
 
-  // (3) wrtie enable
-  digitalWrite(_write_enable_pin, LOW);
+ErrorCode EepromProgrammer::write_step() {
+  // `_write_pos` is past the buffer once the page ends, the states of a byte read it
+  const uint32_t address = _write_start_address + _write_pos;
 
-  // (4) write data
-  _writeData(data);
+  switch (_write_state) {
+    case WriteState::WRITE_IDLE:
+      return _write_result;
 
-  // (5) wrtie disable (initiates the data flush)
-  digitalWrite(_write_enable_pin, HIGH);
+    case WriteState::WRITE_LOAD:
+      // (1) set address
+      _writeAddress(address);
+      // (2) write data, latched on the rising edge of !WE
+      _writeData(_write_buffer[_write_pos]);
+      _write_state = WriteState::WRITE_PULSE;
+      break;
 
-  // (6) polling
-  const unsigned long write_op_start_usec = micros();
-  _write_op_wait_time_usec = 0;
-  _write_op_wait_cycles = -1;
-  if (_rdy_busy_pin > 0) {
-    _rdy_busy_polling(write_op_start_usec, data);
-  } else {
-    _data_polling(write_op_start_usec, data);
+    case WriteState::WRITE_PULSE:
+      // (3) chip enable
+      digitalWrite(_chip_enable_pin, LOW);
+      // the next rising edge of RDY/!BUSY ends the write cycle
+      if (_rdy_busy_interrupt) {
+        rising_edge.arm();
+      }
+      // (4) write enable, held for tWP and tDS of the chip
+      digitalWrite(_write_enable_pin, LOW);
+      delay_loops(_write_pulse_loops);
+      // (5) write disable (initiates the data flush)
+      digitalWrite(_write_enable_pin, HIGH);
+      _write_op_start_ticks = instrument_ticks();
+      _write_op_wait_ticks = 0;
+      _write_op_wait_time_usec = 0;
+      _write_op_wait_cycles = -1;
+      _write_poll_completion = _write_completion;
+      _write_confirmed = false;
+      _write_state = WriteState::WRITE_POLL;
+      break;
+
+    case WriteState::WRITE_POLL:
+      // (6) polling, one check per step
+      if (_write_poll(_write_buffer[_write_pos]) || ticks_to_usec(instrument_ticks() - _write_op_start_ticks) >= _write_timeout_usec) {
+        if (_write_poll_completion == WriteCompletion::DATA_POLLING) {
+          _setDataBusMode(_DataBusMode::WRITE);
+        }
+        // the capture or the interrupt took the time of the edge, the polling slack is not in the wait
+        const bool edge_timed = _rdy_busy_interrupt && _write_poll_completion == WriteCompletion::RDY_BUSY && _write_confirmed;
+        _write_op_wait_ticks = (edge_timed ? rising_edge.get_edge_ticks() : instrument_ticks()) - _write_op_start_ticks;
+        _write_op_wait_time_usec = ticks_to_usec(_write_op_wait_ticks);
+        _write_wait_histogram.add(_write_op_wait_time_usec);
+        STAGE_TRACE(WRITE_POLL_END, _write_op_wait_time_usec);
+        // (7) chip disable
+        digitalWrite(_chip_enable_pin, HIGH);
+        _write_state = WriteState::WRITE_VERIFY;
+      }
+      break;
+
+    case WriteState::WRITE_VERIFY:
+      // a timeout or the fixed delay did not see the byte
+      if (!_write_confirmed && _read_back(address) != _write_buffer[_write_pos]) {
+        return _end_write(ErrorCode::WRITE_FAILED);
+      }
+      _write_state = WriteState::WRITE_NEXT;
+      break;
+
+    case WriteState::WRITE_NEXT:
+      _write_op_wait_time_usec_for_page[_write_pos] = _write_op_wait_time_usec < 0xFFFF ? _write_op_wait_time_usec : 0xFFFF;
+      _write_op_wait_ticks_page_total += _write_op_wait_ticks;
+      _write_pos++;
+      if (_write_pos >= _write_bytes_total) {
+        return _end_write(ErrorCode::SUCCESS);
+      }
+      if (_write_cancel) {
+        return _end_write(ErrorCode::WRITE_CANCELLED);
+      }
+      _write_state = WriteState::WRITE_LOAD;
+      break;
   }
-  _write_op_wait_time_usec = micros() - write_op_start_usec;
 
-  // (7) chip disable
-  digitalWrite(_chip_enable_pin, HIGH);
+  return ErrorCode::WRITE_IN_PROGRESS;
+}
 
-  return ErrorCode::SUCCESS;
+ErrorCode EepromProgrammer::_end_write(const ErrorCode code) {
+  STAGE_TRACE(WRITE_PAGE_END, code);
+  _write_state = WriteState::WRITE_IDLE;
+  _write_cancel = false;
+  _write_result = code;
+  return code;
 }
 
 void EepromProgrammer::_setAddressBusMode() {
-  for (int i = 0; i < _address_bus_size; i++) {
+  for (size_t i = _shift_address_size; i < _address_bus_size; i++) {
     pinMode(_address_bus_pins[i], OUTPUT);
   }
 }
 
 void EepromProgrammer::_setDataBusMode(const EepromProgrammer::_DataBusMode mode) {
   if (mode == EepromProgrammer::_DataBusMode::READ) {
-    for (int i = 0; i < _data_bus_size; i++) {
+    for (size_t i = 0; i < _data_bus_size; i++) {
       pinMode(_data_bus_pins[i], INPUT_PULLUP);
     }
 
   } else if (mode == EepromProgrammer::_DataBusMode::WRITE) {
-    for (int i = 0; i < _data_bus_size; i++) {
+    for (size_t i = 0; i < _data_bus_size; i++) {
       pinMode(_data_bus_pins[i], OUTPUT);
     }
   }
 }
 
 void EepromProgrammer::_writeAddress(const uint32_t address) {
+  if (_shift_address_size > 0) {
+    _shiftAddress(address);
+  }
   const size_t c_address_bus_size = _address_bus_size;
   bool b_address[c_address_bus_size];
   _addressToBitsArray(address, b_address, c_address_bus_size);
-  for (int i = 0; i < c_address_bus_size; i++) {
+  for (size_t i = _shift_address_size; i < c_address_bus_size; i++) {
     digitalWrite(_address_bus_pins[i], b_address[i]);
   }
 }
 
+void EepromProgrammer::_shiftAddress(const uint32_t address) {
+  // bits above the shift size are on GPIOs, the register outputs above them stay low
+  const uint16_t shift_mask = (uint16_t)(((uint32_t)1 << _shift_address_size) - 1);
+  const uint16_t shift_address = (uint16_t)address & shift_mask;
+  const uint8_t low_byte = shift_address & 0xFF;
+  const uint8_t high_byte = shift_address >> 8;
+
+  // both registers see the shifted byte, only the latched one takes it
+  // sequential reads and page writes change the high byte once per 256 addresses
+  if (!_shift_latched || high_byte != _shift_high_byte) {
+    SPI.transfer(high_byte);
+    _pulseLatch(_shift_latch_high_pin);
+    _shift_high_byte = high_byte;
+  }
+  if (!_shift_latched || low_byte != _shift_low_byte) {
+    SPI.transfer(low_byte);
+    _pulseLatch(_shift_latch_low_pin);
+    _shift_low_byte = low_byte;
+  }
+  _shift_latched = true;
+}
+
+void EepromProgrammer::_pulseLatch(const PIN_NO latch_pin) {
+  // RCLK copies the shift stage to the outputs on the rising edge
+  digitalWrite(latch_pin, HIGH);
+  digitalWrite(latch_pin, LOW);
+}
+
 uint8_t EepromProgrammer::_readData() {
   const size_t c_data_bus_size = _data_bus_size;
   bool b_data[c_data_bus_size];
-  for (int i = 0; i < c_data_bus_size; i++) {
+  for (size_t i = 0; i < c_data_bus_size; i++) {
     b_data[i] = digitalRead(_data_bus_pins[i]) == HIGH ? 1 : 0;
   }
   return _bitsArrayToData(b_data, c_data_bus_size);
@@ -542,70 +999,85 @@ void EepromProgrammer::_writeData(const uint8_t data) {
   const size_t c_data_bus_size = _data_bus_size;
   bool b_data[c_data_bus_size];
   _dataToBitsArray(data, b_data, c_data_bus_size);
-  for (int i = 0; i < c_data_bus_size; i++) {
+  for (size_t i = 0; i < c_data_bus_size; i++) {
     digitalWrite(_data_bus_pins[i], b_data[i]);
   }
 }
 
-void EepromProgrammer::_rdy_busy_polling(const unsigned long write_op_start_usec, const uint8_t data) {
-  // wait until device switches to !BUSY state, if chip has the RDY/!BUSY pin
-  // Time to Device Busy (delta between WE and !BUSY) == 50 ms MAX (spec)
-  delayMicroseconds(1);  // arduino cannot delay in ns, only us
-  int currBusyState = digitalRead(_rdy_busy_pin);
-
-  // wait until !BUSY state switches to READY state (1 ms MAX)
-  // or just wait for the Write Cycle Time MAX
-  if (currBusyState == LOW) {
-    // device is in !BUSY state
-    // use the READY/!BUSY pin status to wait for the Write Cycle End
-    _write_op_wait_cycles = 0;
-    const unsigned int delay_usec = 100;
-
-    int prevBusyState = currBusyState;
-    while (write_op_start_usec + _WRITE_SUCCESS_WAITING_TIME_USEC > micros()) {
-      delayMicroseconds(delay_usec);
+// one iteration of the completion loop of the chip, true when the write cycle is over
+bool EepromProgrammer::_write_poll(const uint8_t data) {
+  switch (_write_poll_completion) {
+    case WriteCompletion::RDY_BUSY:
+      if (_write_op_wait_cycles < 0) {
+        // Time to Device Busy (delta between WE and !BUSY)
+        delay_loops(_DEVICE_BUSY_DELAY_LOOPS);
+        if (digitalRead(_rdy_busy_pin) == LOW || (_rdy_busy_interrupt && rising_edge.seen())) {
+          // device is in !BUSY state, wait for READY (1 ms MAX)
+          _write_op_wait_cycles = 0;
+        } else {
+          // device not in !BUSY state, wait the max write-cycle time of the chip
+          _write_poll_completion = WriteCompletion::FIXED_DELAY;
+        }
+        return false;
+      }
       _write_op_wait_cycles += 1;
+      if (_rdy_busy_interrupt) {
+        // no delay, the loop runs until the interrupt sees the edge
+        _write_confirmed = rising_edge.seen();
+        return _write_confirmed;
+      }
+      delayMicroseconds(100);
+      // rising edge
+      _write_confirmed = digitalRead(_rdy_busy_pin) == HIGH;
+      return _write_confirmed;
+
+    case WriteCompletion::DATA_POLLING: {
+      // the data is read until the value matches the one written
+      // during the write procedure, the data pins remain in a metastable state.
+      if (_write_op_wait_cycles < 0) {
+        _setDataBusMode(_DataBusMode::READ);
+        _write_op_wait_cycles = 0;
+      }
+      delayMicroseconds(50);
+      _write_op_wait_cycles += 1;
+
+      // !DATA polling waveforms require to switch !CE and !OE for every attempt
+      digitalWrite(_chip_enable_pin, LOW);
+      digitalWrite(_output_enable_pin, LOW);
+      // tACC and tOE of the chip
+      delay_loops(_output_delay_loops);
+      const uint8_t read_result = _readData();
+      digitalWrite(_output_enable_pin, HIGH);
+      digitalWrite(_chip_enable_pin, HIGH);
+      _write_confirmed = read_result == data;
+      return _write_confirmed;
+    }
 
-      prevBusyState = currBusyState;
-      currBusyState = digitalRead(_rdy_busy_pin);
-      if (prevBusyState == LOW && currBusyState == HIGH) {  // rising edge
-        break;
+    default: {
+      // the max write-cycle time in slices, the loop runs between them
+      const unsigned long elapsed_usec = ticks_to_usec(instrument_ticks() - _write_op_start_ticks);
+      if (elapsed_usec >= _write_cycle_max_usec) {
+        return true;
       }
+      const unsigned long left_usec = _write_cycle_max_usec - elapsed_usec;
+      delayMicroseconds(left_usec < 100 ? left_usec : 100);
+      return false;
     }
-  } else {
-    // device not in !BUSY state
-    // use generic delay
-    delayMicroseconds(_WRITE_SUCCESS_WAITING_TIME_USEC);
   }
 }
 
-void EepromProgrammer::_data_polling(const unsigned long write_op_start_usec, const uint8_t data) {
-  // use !DATA polling, if chip doesn't have the RDY/!BUSY pin
-  // following the data poll waveforms, the data is read in a loop until the value matches the one written
-  // during the write procedure, the data pins remain in a metastable state.
+// a single read on the WRITE bus, the bus goes back to WRITE
+uint8_t EepromProgrammer::_read_back(const uint32_t address) {
   _setDataBusMode(_DataBusMode::READ);
-
-  _write_op_wait_cycles = 0;
-  const unsigned int delay_usec = 50;
-
-  while (write_op_start_usec + _WRITE_SUCCESS_WAITING_TIME_USEC > micros()) {
-    delayMicroseconds(delay_usec);
-    _write_op_wait_cycles += 1;
-
-    // !DATA polling waveforms require to switch !CE and !OE for every attempt
-    digitalWrite(_chip_enable_pin, LOW);
-    digitalWrite(_output_enable_pin, LOW);
-    // !OE to Output Delay (delta between OE and data ready) == 100 ns MAX
-    delayMicroseconds(1);  // arduino cannot delay in ns, only us
-    uint8_t read_result = _readData();
-    digitalWrite(_output_enable_pin, HIGH);
-    digitalWrite(_chip_enable_pin, HIGH);
-    if (read_result == data) {
-      break;
-    }
-  }
-
+  _writeAddress(address);
+  digitalWrite(_chip_enable_pin, LOW);
+  digitalWrite(_output_enable_pin, LOW);
+  delay_loops(_output_delay_loops);
+  const uint8_t data = _readData();
+  digitalWrite(_output_enable_pin, HIGH);
+  digitalWrite(_chip_enable_pin, HIGH);
   _setDataBusMode(_DataBusMode::WRITE);
+  return data;
 }
 
 
@@ -1,6 +1,8 @@
 #ifndef __eeprom_programmer_wiring_h__
 #define __eeprom_programmer_wiring_h__
 
+#include "bus_timing.h"
+
 namespace EepromProgrammerWiring {
 
 enum WiringType : int {
@@ -14,28 +16,29 @@ enum ChipType : int {
   // DIP28
   AT28C64 = 100,
   AT28C256 = 101,
+  // DIP24
+  AT28C16 = 200,
+  EPROM_2716 = 201,
   UNKNOWN = 10000
 };
 
-ChipType str_to_chip_type(const String& chip_type) {
-  String _chip_type = chip_type;
-  _chip_type.toUpperCase();
-  if (_chip_type == "AT28C64") {
-    return ChipType::AT28C64;
-  } else if (_chip_type == "AT28C256") {
-    return ChipType::AT28C256;
-  }
-  return ChipType::UNKNOWN;
-}
-
 typedef uint8_t PIN_NO;
 
+// board pin of socket pin 1 on DIP28 and DIP28_SHIFT: RDY/!BUSY of AT28C64, A14 of AT28C256
+// pin 29 of the stock boards has no input capture, INT or PCINT, the end of the write cycle is
+// polled every 100 us. Rewire the line and build with the new pin to time the edge: 48 (ICP5)
+// latches it in hardware on DIP28, where DIP28_SHIFT uses 48 as a latch; 2 or 3 (INT4/INT5)
+// take it in the interrupt on both boards
+#ifndef DIP28_SOCKET_PIN1
+#define DIP28_SOCKET_PIN1 29
+#endif
+
 
 // ========================================
 // DIP28 WIRING
 // ========================================
 
-// 29  --  1 --|    |-- 28 -- VCC
+// 29  --  1 --|    |-- 28 -- VCC       (pin 1: DIP28_SOCKET_PIN1)
 // 31  --  2 --|    |-- 27 -- 22
 // 33  --  3 --|    |-- 26 -- 24
 // 35  --  4 --|    |-- 25 -- 26
@@ -50,9 +53,10 @@ typedef uint8_t PIN_NO;
 // 53  -- 13 --|    |-- 16 -- 44
 // GND -- 14 --|    |-- 15 -- 46
 
-const PIN_NO DIP28_WIRING[28] = {
+// the socket tables live in flash, read them with pgm_read_byte
+const PIN_NO DIP28_WIRING[28] PROGMEM = {
   // left side, 1-14, top-down
-  29,  // 1
+  DIP28_SOCKET_PIN1,  // 1
   31,  // 2
   33,  // 3
   35,  // 4
@@ -85,9 +89,118 @@ const PIN_NO DIP28_WIRING[28] = {
 
 
 // ========================================
-// Chip WIRING
+// DIP24 WIRING
+// ========================================
+
+// the DIP24 socket is wired in parallel to pins 3-13 and 15-25 of the DIP28 socket,
+// where a bottom-aligned 24 pin chip would sit, VCC and GND are its own
+// use one socket at a time, the DIP28 board takes DIP24 chips through this socket
+//
+// 33  --  1 --|    |-- 24 -- VCC
+// 35  --  2 --|    |-- 23 -- 26
+// 37  --  3 --|    |-- 22 -- 28
+// 39  --  4 --|    |-- 21 -- 30
+// 41  --  5 --|    |-- 20 -- 32
+// 43  --  6 --|    |-- 19 -- 34
+// 45  --  7 --|    |-- 18 -- 36
+// 47  --  8 --|    |-- 17 -- 38
+// 49  --  9 --|    |-- 16 -- 40
+// 51  -- 10 --|    |-- 15 -- 42
+// 53  -- 11 --|    |-- 14 -- 44
+// GND -- 12 --|    |-- 13 -- 46
+
+const PIN_NO DIP24_WIRING[24] PROGMEM = {
+  // left side, 1-12, top-down
+  33, 35, 37, 39, 41, 43, 45, 47, 49, 51, 53, 0,
+  // right side, 13-24, bottom-up
+  46, 44, 42, 40, 38, 36, 34, 32, 30, 28, 26, 0,
+};
+
+
+// ========================================
+// DIP28_SHIFT WIRING
+// ========================================
+
+// the address lines of the socket come from two 74HC595 on the hardware SPI
+// both registers share SER (MOSI 51) and SRCLK (SCK 52), each latches its outputs on its own RCLK
+// so a new low byte is one SPI byte and a latch pulse, the high byte is re-shifted only when it changes
+// !OE of the registers is tied to GND, !SRCLR to VCC
+//
+// low register, RCLK on 53 (SS):  Q0-Q7 -> A0-A7 (socket 10, 9, 8, 7, 6, 5, 4, 3)
+// high register, RCLK on 48:      Q0-Q5 -> A8-A13 (socket 25, 24, 21, 23, 2, 26)
+// socket pin 1 stays on a GPIO, it is A14 of AT28C256 and the RDY/!BUSY output of AT28C64
+//
+// 29  --  1 --|    |-- 28 -- VCC       (pin 1: DIP28_SOCKET_PIN1)
+// Q4H --  2 --|    |-- 27 -- 22
+// Q7L --  3 --|    |-- 26 -- Q5H
+// Q6L --  4 --|    |-- 25 -- Q0H
+// Q5L --  5 --|    |-- 24 -- Q1H
+// Q4L --  6 --|    |-- 23 -- Q3H
+// Q3L --  7 --|    |-- 22 -- 32
+// Q2L --  8 --|    |-- 21 -- Q2H
+// Q1L --  9 --|    |-- 20 -- 36
+// Q0L -- 10 --|    |-- 19 -- 38
+// 49  -- 11 --|    |-- 18 -- 40
+// 47  -- 12 --|    |-- 17 -- 42
+// 45  -- 13 --|    |-- 16 -- 44
+// GND -- 14 --|    |-- 15 -- 46
+
+// socket pins on the shift registers are 0, like VCC and GND
+const PIN_NO DIP28_SHIFT_WIRING[28] PROGMEM = {
+  // left side, 1-14, top-down
+  DIP28_SOCKET_PIN1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 47, 45, 0,
+  // right side, 15-28, bottom-up
+  46, 44, 42, 40, 38, 36, 0, 32, 0, 0, 0, 0, 22, 0,
+};
+
+// socket pins of the register outputs, the low register first, address bit i is output i
+static const size_t DIP28_SHIFT_CHAIN_SIZE = 14;
+const PIN_NO DIP28_SHIFT_CHAIN[DIP28_SHIFT_CHAIN_SIZE] PROGMEM = { 10, 9, 8, 7, 6, 5, 4, 3, 25, 24, 21, 23, 2, 26 };
+// RCLK of the low and the high register
+static const PIN_NO DIP28_SHIFT_LATCH_LOW_PIN = 53;
+static const PIN_NO DIP28_SHIFT_LATCH_HIGH_PIN = 48;
+// SER and SRCLK of both registers, MOSI and SCK of the hardware SPI
+static const PIN_NO DIP28_SHIFT_SER_PIN = 51;
+static const PIN_NO DIP28_SHIFT_SRCLK_PIN = 52;
+
+
+// ========================================
+// Chip Descriptors
 // ========================================
 
+// write completion detection
+enum WriteCompletion : uint8_t {
+  RDY_BUSY = 1,      // RDY/!BUSY pin, DATA polling when it is not wired
+  DATA_POLLING = 2,  // I/O7 reads the complement of the written bit until the cycle ends
+  FIXED_DELAY = 3,   // wait the max write-cycle time
+  READ_ONLY = 4      // EPROM, no write support
+};
+
+// chip features, a bit mask
+enum ChipFeature : uint8_t {
+  PAGE_WRITE = 1,           // bytes of a page share one write cycle
+  SOFTWARE_PROTECTION = 2,  // software data protection (SDP) commands
+  CHIP_ERASE = 4,           // chip erase command
+};
+
+// pins are socket pin numbers, from 1, 0 when the pin is not connected
+struct ChipDescriptor {
+  char name[10];
+  ChipType chip_type;
+  WiringType package;
+  uint8_t address_bus_size;
+  uint8_t data_bus_size;
+  // sized as the WiringController max buses
+  PIN_NO address_bus_pins[15];  // A0 first
+  PIN_NO data_bus_pins[8];      // I/O0 first
+  PIN_NO management_pins[4];    // !CE, !OE, !WE, [RDY/!BUSY]
+  uint8_t write_page_size;      // 1 when the chip writes byte by byte
+  uint16_t write_cycle_max_usec;  // tWC
+  BusTimingLibrary::BusTiming bus_timing;  // tACC, tOE, tWP, tDS and their delay loops
+  WriteCompletion write_completion;
+  uint8_t features;
+};
+
 // AT28C64 / DIP28
 
 // 1  -- | !BSY  VCC |-- VCC
@@ -105,15 +218,6 @@ const PIN_NO DIP28_WIRING[28] = {
 // 13 -- | IO2   IO4 |-- 16
 // 14 -- | GND   IO3 |-- 15
 
-namespace AT28C64_Wiring {
-static const size_t ADDRESS_BUS_SIZE = 13;  // A0-A12
-static const PIN_NO ADDRESS_BUS_PINS[ADDRESS_BUS_SIZE] = { 10, 9, 8, 7, 6, 5, 4, 3, 25, 24, 21, 23, 2 };
-static const size_t DATA_BUS_SIZE = 8;
-static const PIN_NO DATA_BUS_PINS[DATA_BUS_SIZE] = { 11, 12, 13, 15, 16, 17, 18, 19 };
-static const size_t MANAGEMENT_SIZE = 4;
-static const PIN_NO MANAGEMENT_PINS[MANAGEMENT_SIZE] = { 20, 22, 27, 1 };  // !CE, !OE, !WE, !BSY
-}
-
 
 // AT28C256 / DIP28
 
@@ -132,15 +236,74 @@ static const PIN_NO MANAGEMENT_PINS[MANAGEMENT_SIZE] = { 20, 22, 27, 1 };  // !C
 // 13 -- | IO2   IO4 |-- 16
 // 14 -- | GND   IO3 |-- 15
 
-namespace AT28C256_Wiring {
-static const size_t ADDRESS_BUS_SIZE = 15;  // A0-A14
-static const PIN_NO ADDRESS_BUS_PINS[ADDRESS_BUS_SIZE] = { 10, 9, 8, 7, 6, 5, 4, 3, 25, 24, 21, 23, 2, 26, 1 };
-static const size_t DATA_BUS_SIZE = 8;
-static const PIN_NO DATA_BUS_PINS[DATA_BUS_SIZE] = { 11, 12, 13, 15, 16, 17, 18, 19 };
-static const size_t MANAGEMENT_SIZE = 4;
-static const PIN_NO MANAGEMENT_PINS[MANAGEMENT_SIZE] = { 20, 22, 27, 0 };  // !CE, !OE, !WE, [!BSY]
+
+// timing of the slowest speed grade, a faster part works with it
+const ChipDescriptor CHIP_DESCRIPTORS[] PROGMEM = {
+  {
+    "AT28C64", ChipType::AT28C64, WiringType::DIP28,
+    13, 8,
+    { 10, 9, 8, 7, 6, 5, 4, 3, 25, 24, 21, 23, 2 },
+    { 11, 12, 13, 15, 16, 17, 18, 19 },
+    { 20, 22, 27, 1 },
+    1, 1000, BusTimingLibrary::bus_timing_nsec(250, 100, 100, 50),
+    WriteCompletion::RDY_BUSY, 0,
+  },
+  {
+    "AT28C256", ChipType::AT28C256, WiringType::DIP28,
+    15, 8,
+    { 10, 9, 8, 7, 6, 5, 4, 3, 25, 24, 21, 23, 2, 26, 1 },
+    { 11, 12, 13, 15, 16, 17, 18, 19 },
+    { 20, 22, 27, 0 },
+    64, 10000, BusTimingLibrary::bus_timing_nsec(150, 70, 100, 50),
+    WriteCompletion::DATA_POLLING, ChipFeature::PAGE_WRITE | ChipFeature::SOFTWARE_PROTECTION,
+  },
+  {
+    "AT28C16", ChipType::AT28C16, WiringType::DIP24,
+    11, 8,
+    { 8, 7, 6, 5, 4, 3, 2, 1, 23, 22, 19 },
+    { 9, 10, 11, 13, 14, 15, 16, 17 },
+    { 18, 20, 21, 0 },
+    1, 1000, BusTimingLibrary::bus_timing_nsec(150, 70, 100, 50),
+    WriteCompletion::DATA_POLLING, 0,
+  },
+  {
+    // pin 21 is VPP, the !WE line holds it at VCC for reads
+    "2716", ChipType::EPROM_2716, WiringType::DIP24,
+    11, 8,
+    { 8, 7, 6, 5, 4, 3, 2, 1, 23, 22, 19 },
+    { 9, 10, 11, 13, 14, 15, 16, 17 },
+    { 18, 20, 21, 0 },
+    1, 0, BusTimingLibrary::bus_timing_nsec(450, 120, 0, 0),
+    WriteCompletion::READ_ONLY, 0,
+  },
 };
 
+static const size_t CHIP_DESCRIPTORS_SIZE = sizeof(CHIP_DESCRIPTORS) / sizeof(CHIP_DESCRIPTORS[0]);
+
+// copies the descriptor out of flash, false for an unknown chip
+bool get_chip_descriptor(const ChipType chip_type, ChipDescriptor& descriptor) {
+  for (size_t i = 0; i < CHIP_DESCRIPTORS_SIZE; i++) {
+    ChipType descriptor_chip_type;
+    memcpy_P(&descriptor_chip_type, &CHIP_DESCRIPTORS[i].chip_type, sizeof(descriptor_chip_type));
+    if (descriptor_chip_type == chip_type) {
+      memcpy_P(&descriptor, &CHIP_DESCRIPTORS[i], sizeof(ChipDescriptor));
+      return true;
+    }
+  }
+  return false;
+}
+
+ChipType str_to_chip_type(const char* chip_type) {
+  for (size_t i = 0; i < CHIP_DESCRIPTORS_SIZE; i++) {
+    if (strcasecmp_P(chip_type, CHIP_DESCRIPTORS[i].name) == 0) {
+      ChipType descriptor_chip_type;
+      memcpy_P(&descriptor_chip_type, &CHIP_DESCRIPTORS[i].chip_type, sizeof(descriptor_chip_type));
+      return descriptor_chip_type;
+    }
+  }
+  return ChipType::UNKNOWN;
+}
+
 
 class WiringController {
 public:
@@ -148,26 +311,83 @@ public:
   static const size_t MAX_ADDRESS_BUS_SIZE = 15;  // AT28C256: A0 to A14
   static const size_t MAX_DATA_BUS_SIZE = 8;      // AT28C256: I/O0 to I/O7
   static const size_t MAX_MANAGEMENT_SIZE = 4;    // CE, OE, WE, BSY
+  static const size_t MAX_WIRED_PINS = MAX_BOARD_BUS_SIZE + 4;  // the socket, latches, SER, SRCLK
 
   WiringController(const WiringType wiring_type)
-    : _wiring_type(wiring_type) {}
+    : _wiring_type(wiring_type), _chip_type(ChipType::UNKNOWN), _shift_address_size(0) {}
 
+  // an unknown chip, or a chip of another package, leaves the controller without a chip
   void set_chip_type(const ChipType chip_type) {
+    _chip_type = ChipType::UNKNOWN;
+    _shift_address_size = 0;
+    if (!EepromProgrammerWiring::get_chip_descriptor(chip_type, _chip)) {
+      return;
+    }
+    // the DIP28 board has the DIP24 socket in parallel
+    const bool dip24_on_dip28 = _wiring_type == WiringType::DIP28 && _chip.package == WiringType::DIP24;
+    if (_chip.package != get_package() && !dip24_on_dip28) {
+      return;
+    }
+    if (_wiring_type == WiringType::DIP28_SHIFT) {
+      // the leading address bits that sit on the register outputs in order
+      while (_shift_address_size < _chip.address_bus_size && _shift_address_size < DIP28_SHIFT_CHAIN_SIZE
+             && _chip.address_bus_pins[_shift_address_size] == pgm_read_byte(&DIP28_SHIFT_CHAIN[_shift_address_size])) {
+        _shift_address_size++;
+      }
+    }
     _chip_type = chip_type;
   }
   ChipType get_chip_type() {
     return _chip_type;
   }
+  // valid when the chip type is known
+  const ChipDescriptor& get_chip_descriptor() {
+    return _chip;
+  }
+
+  // the package of the socket
+  WiringType get_package() {
+    switch (_wiring_type) {
+      case WiringType::DIP28_SHIFT:
+        return WiringType::DIP28;
+      case WiringType::DIP24_SHIFT:
+        return WiringType::DIP24;
+      default:
+        return _wiring_type;
+    }
+  }
+
+  // shift-register address wirings: the low address bits on the registers, 0 for direct wirings
+  // their pins in `get_address_bus_pins` are 0, the bits above stay on GPIOs
+  size_t get_shift_address_size() {
+    return _shift_address_size;
+  }
+  void get_shift_latch_pins(PIN_NO& latch_low_pin, PIN_NO& latch_high_pin) {
+    latch_low_pin = 0;
+    latch_high_pin = 0;
+    if (_wiring_type == WiringType::DIP28_SHIFT) {
+      latch_low_pin = DIP28_SHIFT_LATCH_LOW_PIN;
+      latch_high_pin = DIP28_SHIFT_LATCH_HIGH_PIN;
+    }
+  }
 
   size_t get_board_bus_pins(PIN_NO* pins_array, const size_t array_size) {
     size_t board_bus_size = 0;
-    PIN_NO* board_bus_pins = 0;
+    const PIN_NO* board_bus_pins = 0;
 
     switch (_wiring_type) {
       case WiringType::DIP28:
         board_bus_size = 28;
         board_bus_pins = DIP28_WIRING;
         break;
+      case WiringType::DIP28_SHIFT:
+        board_bus_size = 28;
+        board_bus_pins = DIP28_SHIFT_WIRING;
+        break;
+      case WiringType::DIP24:
+        board_bus_size = 24;
+        board_bus_pins = DIP24_WIRING;
+        break;
       default:
         break;
     }
@@ -179,145 +399,102 @@ public:
       return -1;
     }
 
-    // memcpu
-    for (size_t i = 0; i < board_bus_size; i++) {
-      pins_array[i] = board_bus_pins[i];
-    }
+    memcpy_P(pins_array, board_bus_pins, board_bus_size);
     return board_bus_size;
   }
 
-  size_t get_address_bus_pins(PIN_NO* pins_array, const size_t array_size) {
-    size_t address_bus_size = 0;
-    PIN_NO* address_bus_pins = 0;
-    PIN_NO* dip_wiring_mapping = 0;
-
-    switch (_wiring_type) {
-      case WiringType::DIP28:
-        dip_wiring_mapping = DIP28_WIRING;
-        switch (_chip_type) {
-          case ChipType::AT28C64:
-            address_bus_size = AT28C64_Wiring::ADDRESS_BUS_SIZE;
-            address_bus_pins = AT28C64_Wiring::ADDRESS_BUS_PINS;
-            break;
-          case ChipType::AT28C256:
-            address_bus_size = AT28C256_Wiring::ADDRESS_BUS_SIZE;
-            address_bus_pins = AT28C256_Wiring::ADDRESS_BUS_PINS;
-            break;
-          default:
-            break;
-        }
-        break;
-      default:
-        break;
-    }
-
-    if (dip_wiring_mapping == 0) {
+  // the board pins the wiring drives or reads in other roles than the socket line of `pin`:
+  // every socket pin and the latch and SPI pins of the shift registers, less one use of `pin`
+  size_t get_other_wired_pins(const PIN_NO pin, PIN_NO* pins_array, const size_t array_size) {
+    PIN_NO board_bus_pins[MAX_BOARD_BUS_SIZE];
+    const size_t board_bus_size = get_board_bus_pins(board_bus_pins, MAX_BOARD_BUS_SIZE);
+    if (board_bus_size == (size_t)-1 || array_size < MAX_WIRED_PINS) {
       return -1;
     }
-    if (address_bus_size == 0 || address_bus_pins == 0) {
-      return -1;
+
+    PIN_NO wired_pins[MAX_WIRED_PINS];
+    size_t wired_size = 0;
+    for (size_t i = 0; i < board_bus_size; i++) {
+      if (board_bus_pins[i] != 0) {
+        wired_pins[wired_size++] = board_bus_pins[i];
+      }
     }
-    if (array_size < address_bus_size) {
-      return -1;
+    if (_wiring_type == WiringType::DIP28_SHIFT) {
+      wired_pins[wired_size++] = DIP28_SHIFT_LATCH_LOW_PIN;
+      wired_pins[wired_size++] = DIP28_SHIFT_LATCH_HIGH_PIN;
+      wired_pins[wired_size++] = DIP28_SHIFT_SER_PIN;
+      wired_pins[wired_size++] = DIP28_SHIFT_SRCLK_PIN;
     }
 
-    // mapping
-    for (size_t i = 0; i < address_bus_size; i++) {
-      // mapping starts from 0, but PIN numbers start from 1 for convenience
-      pins_array[i] = dip_wiring_mapping[address_bus_pins[i] - 1];
+    size_t size = 0;
+    bool own_line = false;
+    for (size_t i = 0; i < wired_size; i++) {
+      if (!own_line && wired_pins[i] == pin) {
+        own_line = true;
+        continue;
+      }
+      pins_array[size++] = wired_pins[i];
     }
-    return address_bus_size;
+    return size;
   }
 
-  size_t get_data_bus_pins(PIN_NO* pins_array, const size_t array_size) {
-    size_t data_bus_size = 0;
-    PIN_NO* data_bus_pins = 0;
-    PIN_NO* dip_wiring_mapping = 0;
-
-    switch (_wiring_type) {
-      case WiringType::DIP28:
-        dip_wiring_mapping = DIP28_WIRING;
-        switch (_chip_type) {
-          case ChipType::AT28C64:
-            data_bus_size = AT28C64_Wiring::DATA_BUS_SIZE;
-            data_bus_pins = AT28C64_Wiring::DATA_BUS_PINS;
-            break;
-          case ChipType::AT28C256:
-            data_bus_size = AT28C256_Wiring::DATA_BUS_SIZE;
-            data_bus_pins = AT28C256_Wiring::DATA_BUS_PINS;
-            break;
-          default:
-            break;
-        }
-        break;
-      default:
-        break;
-    }
-
-    if (dip_wiring_mapping == 0) {
-      return -1;
-    }
-    if (data_bus_size == 0 || data_bus_pins == 0) {
-      return -1;
-    }
-    if (array_size < data_bus_size) {
-      return -1;
-    }
+  size_t get_address_bus_pins(PIN_NO* pins_array, const size_t array_size) {
+    return _map_chip_pins(_chip.address_bus_pins, _chip.address_bus_size, pins_array, array_size);
+  }
 
-    // mapping
-    for (size_t i = 0; i < data_bus_size; i++) {
-      // mapping starts from 0, but PIN numbers start from 1 for convenience
-      pins_array[i] = dip_wiring_mapping[data_bus_pins[i] - 1];
-    }
-    return data_bus_size;
+  size_t get_data_bus_pins(PIN_NO* pins_array, const size_t array_size) {
+    return _map_chip_pins(_chip.data_bus_pins, _chip.data_bus_size, pins_array, array_size);
   }
 
   size_t get_management_pins(PIN_NO* pins_array, const size_t array_size) {
-    size_t management_size = 0;
-    PIN_NO* management_pins = 0;
-    PIN_NO* dip_wiring_mapping = 0;
+    return _map_chip_pins(_chip.management_pins, MAX_MANAGEMENT_SIZE, pins_array, array_size);
+  }
 
+private:
+  WiringType _wiring_type;
+  ChipType _chip_type;
+  ChipDescriptor _chip;
+  size_t _shift_address_size;
+
+  const PIN_NO* _get_dip_wiring_mapping() {
+    if (_chip_type != ChipType::UNKNOWN && _chip.package == WiringType::DIP24) {
+      return DIP24_WIRING;
+    }
     switch (_wiring_type) {
       case WiringType::DIP28:
-        dip_wiring_mapping = DIP28_WIRING;
-        switch (_chip_type) {
-          case ChipType::AT28C64:
-            management_size = AT28C64_Wiring::MANAGEMENT_SIZE;
-            management_pins = AT28C64_Wiring::MANAGEMENT_PINS;
-            break;
-          case ChipType::AT28C256:
-            management_size = AT28C256_Wiring::MANAGEMENT_SIZE;
-            management_pins = AT28C256_Wiring::MANAGEMENT_PINS;
-            break;
-          default:
-            break;
-        }
-        break;
+        return DIP28_WIRING;
+      case WiringType::DIP28_SHIFT:
+        return DIP28_SHIFT_WIRING;
       default:
-        break;
+        return 0;
     }
+  }
 
-    if (dip_wiring_mapping == 0) {
+  // socket pins of the chip to board pins
+  size_t _map_chip_pins(const PIN_NO* chip_pins, const size_t chip_pins_size, PIN_NO* pins_array, const size_t array_size) {
+    const PIN_NO* dip_wiring_mapping = _get_dip_wiring_mapping();
+    if (dip_wiring_mapping == 0 || _chip_type == ChipType::UNKNOWN) {
       return -1;
     }
-    if (management_size == 0 || management_pins == 0) {
+    if (chip_pins_size == 0) {
       return -1;
     }
-    if (array_size < management_size) {
+    if (array_size < chip_pins_size) {
       return -1;
     }
 
     // mapping
-    for (size_t i = 0; i < management_size; i++) {
+    for (size_t i = 0; i < chip_pins_size; i++) {
+      // optional pins (!BSY) are 0 when not connected, keep them 0
+      if (chip_pins[i] == 0) {
+        pins_array[i] = 0;
+        continue;
+      }
       // mapping starts from 0, but PIN numbers start from 1 for convenience
-      pins_array[i] = dip_wiring_mapping[management_pins[i] - 1];
+      pins_array[i] = pgm_read_byte(&dip_wiring_mapping[chip_pins[i] - 1]);
     }
-    return management_size;
+    return chip_pins_size;
   }
-
-private:
-  WiringType _wiring_type;
-  ChipType _chip_type;
 };
 
 }  // EepromProgrammerWiring
@@ -0,0 +1,71 @@
+#ifndef __instrument_clock_h__
+#define __instrument_clock_h__
+
+// Instrument Clock
+// the clock of the write timing stats: Timer1 free running at F_CPU, 62.5 ns ticks at 16 MHz,
+// extended to 32 bits by its overflow interrupt (268 s before the ticks wrap). micros() counts
+// in 4 us steps and its interrupt jitters the reading, the Timer1 count does neither
+//
+// the firmware takes Timer1 over: no analogWrite on its PWM pins (11, 12, 13), no Servo
+// other targets and the host build count the micros() clock in ticks
+
+namespace InstrumentClockLibrary {
+
+static const uint32_t TICKS_PER_USEC = F_CPU / 1000000UL;
+
+// ticks to usec, rounded
+inline uint32_t ticks_to_usec(const uint32_t ticks) {
+  return (ticks + TICKS_PER_USEC / 2) / TICKS_PER_USEC;
+}
+
+#if defined(__AVR__)
+
+// the high word of the ticks
+static volatile uint16_t _timer1_overflows = 0;
+
+// Timer1 in normal mode, no prescaler, overflow interrupt on
+static void begin_instrument_clock() {
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TCCR1C = 0;
+  TCNT1 = 0;
+  _timer1_overflows = 0;
+  TIFR1 = _BV(TOV1);
+  TIMSK1 = _BV(TOIE1);
+  interrupts();
+}
+
+// safe in an interrupt: SREG is restored, not set
+static uint32_t instrument_ticks() {
+  const uint8_t sreg = SREG;
+  cli();
+  const uint16_t count = TCNT1;
+  uint16_t overflows = _timer1_overflows;
+  // the count wrapped after the interrupts went off, the overflow interrupt is still pending
+  if ((TIFR1 & _BV(TOV1)) && count < 0x8000) {
+    overflows++;
+  }
+  SREG = sreg;
+  return ((uint32_t)overflows << 16) | count;
+}
+
+#else
+
+static void begin_instrument_clock() {}
+
+static uint32_t instrument_ticks() {
+  return micros() * TICKS_PER_USEC;
+}
+
+#endif  // __AVR__
+
+}  // InstrumentClockLibrary
+
+#if defined(__AVR__)
+ISR(TIMER1_OVF_vect) {
+  InstrumentClockLibrary::_timer1_overflows++;
+}
+#endif
+
+#endif  // !__instrument_clock_h__
@@ -0,0 +1,83 @@
+#ifndef __latency_histogram_h__
+#define __latency_histogram_h__
+
+namespace LatencyHistogramLibrary {
+
+// Latency Histogram
+// fixed log-scaled buckets, two per octave of usec: [0, 2), [2, 3), [3, 4), [4, 6), [6, 8), [8, 12) ...
+// the last bucket is open-ended from 2^16 us (65 ms); the client estimates percentiles from the buckets
+
+class LatencyHistogram {
+public:
+  static const uint8_t BUCKETS = 32;
+
+  LatencyHistogram() {
+    reset();
+  }
+
+  void reset() {
+    _count = 0;
+    _min_usec = 0;
+    _max_usec = 0;
+    _sum_usec = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+      _buckets[i] = 0;
+    }
+  }
+
+  void add(const uint32_t value_usec) {
+    if (_count == 0 || value_usec < _min_usec) {
+      _min_usec = value_usec;
+    }
+    if (value_usec > _max_usec) {
+      _max_usec = value_usec;
+    }
+    _count++;
+    _sum_usec += value_usec;
+    _buckets[bucket_index(value_usec)]++;
+  }
+
+  uint32_t get_count() const {
+    return _count;
+  }
+  uint32_t get_min_usec() const {
+    return _min_usec;
+  }
+  uint32_t get_max_usec() const {
+    return _max_usec;
+  }
+  // wraps after 71 minutes of accumulated time
+  uint32_t get_sum_usec() const {
+    return _sum_usec;
+  }
+  uint32_t get_bucket(const uint8_t bucket) const {
+    return bucket < BUCKETS ? _buckets[bucket] : 0;
+  }
+
+  // octave of the value and the bit below its MSB, a shift loop is cheaper than log2 on AVR
+  static uint8_t bucket_index(const uint32_t value_usec) {
+    if (value_usec < 2) {
+      return 0;
+    }
+    uint8_t msb = 0;
+    uint32_t value = value_usec;
+    while (value > 1) {
+      value >>= 1;
+      msb++;
+    }
+    const uint8_t half = (value_usec >> (msb - 1)) & 1;
+    const uint8_t index = 2 * msb - 1 + half;
+    return index < BUCKETS ? index : BUCKETS - 1;
+  }
+
+private:
+  uint32_t _count;
+  uint32_t _min_usec;
+  uint32_t _max_usec;
+  uint32_t _sum_usec;
+  uint32_t _buckets[BUCKETS];
+};
+
+}  // LatencyHistogramLibrary
+
+#endif  // !__latency_histogram_h__
@@ -0,0 +1,154 @@
+#ifndef __memory_stats_h__
+#define __memory_stats_h__
+
+// Memory Stats
+// SRAM use of the board for `get_memory`: static data, free heap, the largest block malloc can
+// return, and the stack high-water mark
+//
+// the SRAM between the heap and the stack is painted with a canary byte at boot, before the
+// C runtime sets up the stack; the deepest stack since then is the lowest byte above the heap
+// that lost the paint. `repaint_stack` restarts the measurement from the current stack depth
+//
+// the AVR layout comes from avr-libc (__heap_start, __brkval, __flp, __malloc_margin), other
+// targets and the host build report MEMORY_UNSUPPORTED
+
+namespace MemoryStatsLibrary {
+
+static const uint8_t STACK_CANARY = 0xC5;
+
+// the value of every SRAM figure on targets without the avr-libc layout
+static const int32_t MEMORY_UNSUPPORTED = -1;
+
+#if defined(__AVR__)
+
+extern "C" {
+// end of .bss, the heap starts here
+extern uint8_t _end;
+// the top of SRAM, the stack starts here
+extern uint8_t __stack;
+extern char __heap_start;
+// the top of the heap, 0 until the first malloc
+extern char* __brkval;
+// malloc keeps this much between the heap and SP
+extern size_t __malloc_margin;
+}
+
+// the avr-libc free list: freed chunks below __brkval
+struct __freelist {
+  size_t sz;
+  struct __freelist* nx;
+};
+extern "C" struct __freelist* __flp;
+
+// runs from .init1: no stack and no zero register yet, so plain asm over [_end, __stack]
+// a naked function takes basic asm only, 0xc5 is STACK_CANARY
+void _paint_stack() __attribute__((naked, used, section(".init1")));
+void _paint_stack() {
+  __asm volatile(
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, 0xc5\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:\n"
+    "    st Z+, r24\n"
+    "2:\n"
+    "    cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n");
+}
+
+static uint8_t* _heap_top() {
+  return __brkval != 0 ? (uint8_t*)__brkval : (uint8_t*)&__heap_start;
+}
+
+// .data and .bss
+static int32_t get_static_bytes() {
+  return (size_t)&__heap_start - RAMSTART;
+}
+
+// the gap between the heap and the stack plus the free list
+static int32_t get_free_heap_bytes() {
+  uint8_t stack_top;
+  size_t free_bytes = &stack_top > _heap_top() ? &stack_top - _heap_top() : 0;
+  for (struct __freelist* chunk = __flp; chunk != 0; chunk = chunk->nx) {
+    free_bytes += chunk->sz + sizeof(size_t);
+  }
+  return free_bytes;
+}
+
+// the largest malloc that succeeds now: a chunk of the free list, or the top of the heap
+// up to __malloc_margin below SP
+static int32_t get_largest_free_block_bytes() {
+  uint8_t stack_top;
+  const size_t gap = &stack_top > _heap_top() ? &stack_top - _heap_top() : 0;
+  size_t largest = gap > __malloc_margin ? gap - __malloc_margin : 0;
+  for (struct __freelist* chunk = __flp; chunk != 0; chunk = chunk->nx) {
+    if (chunk->sz > largest) {
+      largest = chunk->sz;
+    }
+  }
+  return largest;
+}
+
+// the lowest stack byte written since the paint: walk up from the heap top over the paint to
+// the first byte that lost it. A walk down from SP would stop at the paint a deeper frame left
+// unwritten (a message buffer, a page-sized array) and miss the frames below it; here only the
+// deepest bytes equal to the canary are missed
+static uint8_t* _stack_low_water() {
+  uint8_t stack_top;
+  uint8_t* p = _heap_top();
+  while (p < &stack_top && *p == STACK_CANARY) {
+    p++;
+  }
+  return p;
+}
+
+// bytes of the deepest stack since the paint, interrupts included
+static int32_t get_stack_peak_bytes() {
+  return &__stack - _stack_low_water() + 1;
+}
+
+// painted bytes left below the deepest stack, the smallest gap between the heap and the stack
+// since the paint as long as the heap did not grow into it
+static int32_t get_stack_headroom_bytes() {
+  return _stack_low_water() - _heap_top();
+}
+
+// paints [heap top, SP - margin), the margin keeps the frames of this call and of the
+// interrupts firing during the loop out of the paint
+static void repaint_stack() {
+  static const uint8_t _REPAINT_MARGIN = 32;
+  uint8_t stack_top;
+  uint8_t* p = _heap_top();
+  uint8_t* end = &stack_top - _REPAINT_MARGIN;
+  while (p < end) {
+    *p++ = STACK_CANARY;
+  }
+}
+
+#else
+
+static int32_t get_static_bytes() {
+  return MEMORY_UNSUPPORTED;
+}
+static int32_t get_free_heap_bytes() {
+  return MEMORY_UNSUPPORTED;
+}
+static int32_t get_largest_free_block_bytes() {
+  return MEMORY_UNSUPPORTED;
+}
+static int32_t get_stack_peak_bytes() {
+  return MEMORY_UNSUPPORTED;
+}
+static int32_t get_stack_headroom_bytes() {
+  return MEMORY_UNSUPPORTED;
+}
+static void repaint_stack() {}
+
+#endif  // __AVR__
+
+}  // MemoryStatsLibrary
+
+#endif  // !__memory_stats_h__
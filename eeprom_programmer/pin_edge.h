@@ -0,0 +1,215 @@
+#ifndef __pin_edge_h__
+#define __pin_edge_h__
+
+// Pin Edge
+// the instrument clock ticks of the first rising edge of one input pin after `arm`: latched by
+// the input capture unit of Timer4/Timer5 on their ICP pins, otherwise taken in the interrupt of
+// the pin, the external INTn through attachInterrupt or the pin-change interrupt of its port
+// a pin without any of them is not attached, the caller polls it, and so is a pin the board
+// wiring uses in another role: its capture or interrupt would fire on that line
+//
+// the pin-change interrupt is opt-in: with PIN_EDGE_PCINT defined the PCINT vectors are defined
+// here and the sketch cannot link another pin-change user (SoftwareSerial), without it a pin that
+// has only a pin-change interrupt is polled
+// a capture pin takes its timer over, like Timer1 for the instrument clock
+
+#include "instrument_clock.h"
+
+namespace PinEdgeLibrary {
+
+#if defined(__AVR__) && defined(ICR4) && defined(ICR5)
+// Arduino Mega: ICP1 and ICP3 are not broken out; 49 is I/O0 of the sockets and 48 the high latch
+// of DIP28_SHIFT, so only the plain DIP28 board has a free capture pin, 48. The stock boards have
+// RDY/!BUSY on pin 29: the capture measures no write cycle until the line is moved to 48
+// (DIP28_SOCKET_PIN1), `init_chip` reports the timing in use
+static const uint8_t ICP4_PIN = 49;
+static const uint8_t ICP5_PIN = 48;
+#endif
+
+class RisingEdge {
+public:
+  RisingEdge()
+    : _pin(0), _source(_Source::NONE), _armed(false), _seen(false), _edge_ticks(0) {}
+
+  // false when the pin has neither input capture nor interrupt, or is one of `wired_pins`,
+  // the pins the wiring uses in other roles
+  bool attach(const uint8_t pin, const uint8_t* wired_pins, const size_t wired_pins_size);
+
+  bool is_attached() const {
+    return _source != _Source::NONE;
+  }
+  // the edge time is the hardware latch of the timer, not the interrupt entry
+  bool is_captured() const {
+    return _source == _Source::CAPTURE;
+  }
+  uint8_t get_pin() const {
+    return _pin;
+  }
+
+  // forgets the last edge, the next rising edge is recorded
+  void arm() {
+    noInterrupts();
+    _seen = false;
+    _armed = true;
+    interrupts();
+  }
+
+  bool seen() const {
+    return _seen;
+  }
+
+  // instrument clock ticks, valid when `seen`
+  uint32_t get_edge_ticks() {
+    noInterrupts();
+    const uint32_t edge_ticks = _edge_ticks;
+    interrupts();
+    return edge_ticks;
+  }
+
+  // from the interrupt, a pin change fires on both edges
+  void on_change() {
+    if (!_armed) {
+      return;
+    }
+    if (_source == _Source::PIN_CHANGE && !_read_pin()) {
+      return;
+    }
+    _edge_ticks = InstrumentClockLibrary::instrument_ticks();
+    _seen = true;
+    _armed = false;
+  }
+
+  // from the capture interrupt, the timer latched the edge `age_ticks` ago; the instrument clock
+  // is read a few cycles after the capture timer, the edge comes out as many ticks late
+  void on_capture(const uint16_t age_ticks) {
+    if (!_armed) {
+      return;
+    }
+    _edge_ticks = InstrumentClockLibrary::instrument_ticks() - age_ticks;
+    _seen = true;
+    _armed = false;
+  }
+
+private:
+  enum _Source : uint8_t {
+    NONE,
+    CAPTURE,     // ICPn, rising edge
+    EXTERNAL,    // INTn, RISING
+    PIN_CHANGE,  // PCINTn, any change
+  };
+
+  bool _read_pin() {
+#if defined(__AVR__)
+    return (*_pin_input_register & _pin_bit_mask) != 0;
+#else
+    return digitalRead(_pin) == HIGH;
+#endif
+  }
+
+  uint8_t _pin;
+  _Source _source;
+  volatile bool _armed;
+  volatile bool _seen;
+  volatile uint32_t _edge_ticks;
+#if defined(__AVR__)
+  // the pin is read in the interrupt, digitalRead takes too long there
+  volatile uint8_t* _pin_input_register;
+  uint8_t _pin_bit_mask;
+#endif
+};
+
+// one edge per firmware, the interrupt vectors reach it
+static RisingEdge rising_edge;
+
+static void _on_rising_edge_interrupt() {
+  rising_edge.on_change();
+}
+
+bool RisingEdge::attach(const uint8_t pin, const uint8_t* wired_pins, const size_t wired_pins_size) {
+  _pin = pin;
+  _source = _Source::NONE;
+  for (size_t i = 0; i < wired_pins_size; i++) {
+    if (wired_pins[i] == pin) {
+      return false;
+    }
+  }
+#if defined(__AVR__)
+  _pin_input_register = portInputRegister(digitalPinToPort(pin));
+  _pin_bit_mask = digitalPinToBitMask(pin);
+#endif
+
+#if defined(__AVR__) && defined(ICR4) && defined(ICR5)
+  // the counter runs at F_CPU like Timer1, the capture is read back against it
+  if (pin == ICP4_PIN) {
+    noInterrupts();
+    TCCR4A = 0;
+    TCCR4B = _BV(ICES4) | _BV(CS40);
+    TIFR4 = _BV(ICF4);
+    TIMSK4 = _BV(ICIE4);
+    interrupts();
+    _source = _Source::CAPTURE;
+    return true;
+  }
+  if (pin == ICP5_PIN) {
+    noInterrupts();
+    TCCR5A = 0;
+    TCCR5B = _BV(ICES5) | _BV(CS50);
+    TIFR5 = _BV(ICF5);
+    TIMSK5 = _BV(ICIE5);
+    interrupts();
+    _source = _Source::CAPTURE;
+    return true;
+  }
+#endif
+
+  if (digitalPinToInterrupt(pin) != NOT_AN_INTERRUPT) {
+    attachInterrupt(digitalPinToInterrupt(pin), _on_rising_edge_interrupt, RISING);
+    _source = _Source::EXTERNAL;
+    return true;
+  }
+
+#if defined(__AVR__) && defined(PCICR) && defined(PIN_EDGE_PCINT)
+  if (digitalPinToPCICR(pin) != 0) {
+    *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+    *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+    _source = _Source::PIN_CHANGE;
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+}  // PinEdgeLibrary
+
+#if defined(__AVR__) && defined(PCICR) && defined(PIN_EDGE_PCINT)
+#ifdef PCINT0_vect
+ISR(PCINT0_vect) {
+  PinEdgeLibrary::rising_edge.on_change();
+}
+#endif
+#ifdef PCINT1_vect
+ISR(PCINT1_vect) {
+  PinEdgeLibrary::rising_edge.on_change();
+}
+#endif
+#ifdef PCINT2_vect
+ISR(PCINT2_vect) {
+  PinEdgeLibrary::rising_edge.on_change();
+}
+#endif
+#endif  // PIN_EDGE_PCINT
+
+#if defined(__AVR__) && defined(ICR4) && defined(ICR5)
+// the age of the capture is read first, the instrument clock right after
+ISR(TIMER4_CAPT_vect) {
+  const uint16_t age_ticks = TCNT4 - ICR4;
+  PinEdgeLibrary::rising_edge.on_capture(age_ticks);
+}
+ISR(TIMER5_CAPT_vect) {
+  const uint16_t age_ticks = TCNT5 - ICR5;
+  PinEdgeLibrary::rising_edge.on_capture(age_ticks);
+}
+#endif  // ICR4
+
+#endif  // !__pin_edge_h__
@@ -2,13 +2,25 @@
 #define __serial_json_rpc_lib_h__
 
 #include <ArduinoJson.h>
+#include <stdarg.h>
+
+// the request documents use the v6 API (DynamicJsonDocument, JSON_ARRAY_SIZE)
+#if ARDUINOJSON_VERSION_MAJOR != 6
+#error "ArduinoJson v6 is required, see env/fetch_arduinojson.sh"
+#endif
+
+#include "latency_histogram.h"
+#include "stage_trace.h"
+
+using namespace LatencyHistogramLibrary;
 
 namespace SerialJsonRpcLibrary {
 
 class SerialJsonRpcBoard {
 
-  // request_id, method, params[], params_size
-  using RpcProcessor = void (*)(int, const String&, const String[], int);
+  // request_id, method, params
+  // method and params point into the receive buffer, valid until the processor returns
+  using RpcProcessor = void (*)(int, const char*, JsonArray);
 
 public:
   SerialJsonRpcBoard(RpcProcessor rpc_processor);
@@ -16,32 +28,143 @@ public:
   void init();
   void loop();
 
+  // responses are streamed to Serial, no JSON document in SRAM
+  // the _P variants take a printf format in flash (PSTR)
   void send_result_string(int id, const char* string);
-  void send_result_bytes(int id, uint8_t* buffer, int buffer_size);
-  void send_result_ints(int id, int32_t* buffer, int buffer_size);
-  void send_error(int id, int error_code, const char* error_message, const char* error_data);
+  void send_result_string_P(int id, PGM_P format, ...);
+  void send_result_bytes(int id, const uint8_t* buffer, int buffer_size);
+  void send_result_ints(int id, const int32_t* buffer, int buffer_size);
+  // streamed result array
+  void begin_result_array(int id);
+  void add_result_array_int(int32_t value);
+  void end_result_array();
+  // the message is in flash, the data in SRAM
+  void send_error(int id, int error_code, PGM_P error_message, const char* error_data);
+  void send_error_P(int id, int error_code, PGM_P error_message, PGM_P error_data_format, ...);
+
+  // stage timing, cumulative since the last reset
+  unsigned long get_requests_count() {
+    return requests_count;
+  }
+  unsigned long get_parse_time_usec() {
+    return parse_time_usec;
+  }
+  unsigned long get_send_time_usec() {
+    return send_time_usec;
+  }
+  void reset_stage_times() {
+    requests_count = 0;
+    parse_time_usec = 0;
+    send_time_usec = 0;
+  }
+
+  // link counters, cumulative since the last reset
+  unsigned long get_bytes_received() {
+    return link_bytes_received;
+  }
+  unsigned long get_bytes_sent() {
+    return link_bytes_sent;
+  }
+  unsigned long get_frames() {
+    return link_frames;
+  }
+  unsigned long get_parse_errors() {
+    return link_parse_errors;
+  }
+  unsigned long get_overflows() {
+    return link_overflows;
+  }
+  unsigned long get_flush_time_usec() {
+    return link_flush_time_usec;
+  }
+  void reset_link_stats() {
+    link_bytes_received = 0;
+    link_bytes_sent = 0;
+    link_frames = 0;
+    link_parse_errors = 0;
+    link_overflows = 0;
+    link_flush_time_usec = 0;
+  }
+
+  // peak request sizes since the last reset: the JSON document capacity and the bytes the
+  // parser filled, the longest message in the receive buffer
+  size_t get_request_doc_peak_capacity() {
+    return request_doc_peak_capacity;
+  }
+  size_t get_request_doc_peak_usage() {
+    return request_doc_peak_usage;
+  }
+  size_t get_message_peak_bytes() {
+    return message_peak_bytes;
+  }
+  void reset_memory_peaks() {
+    request_doc_peak_capacity = 0;
+    request_doc_peak_usage = 0;
+    message_peak_bytes = 0;
+  }
+
+  // latency distributions, kept for the whole session
+  LatencyHistogram& get_parse_histogram() {
+    return parse_histogram;
+  }
+  LatencyHistogram& get_send_histogram() {
+    return send_histogram;
+  }
 
   // helpers
-  static size_t json_array_to_byte_array(const String& raw_json, uint8_t* byte_array, size_t array_size);
+  static size_t json_array_to_byte_array(JsonArray json_array, uint8_t* byte_array, size_t array_size);
 
 private:
   // default baudrate
   static const unsigned long _DEFAULT_BAUDRATE = 115200;
 
   // balance between the protocol throughput and the board memory limit
-  // works fine for UNO R3
-  static const int _JSON_RPC_BUFFER_SIZE = 350;
+  // holds a `write_page` request of 128 bytes
+  static const int _JSON_RPC_BUFFER_SIZE = 600;
+
+  // error data and formatted results, longer text is cut
+  static const size_t _MESSAGE_BUFFER_SIZE = 72;
 
   // use \n for simiplicity to use both py-client and Arduino Serial Monitor
   static const char _END_OF_JSON_RPC_MESSAGE = '\n';
 
+  size_t _request_capacity();
   void _process_request(JsonDocument& request);
+  void _end_parse();
+  void _end_send(const unsigned long start_usec);
+  void _flush();
 
-  DynamicJsonDocument _get_response(int id, int data_size);
-  void _send_response(const DynamicJsonDocument &response);
+  // {"jsonrpc":"2.0","id":<id>,  ...  }\n
+  unsigned long _begin_response(int id);
+  void _end_response(const unsigned long start_usec);
+  void _print_P(PGM_P string);
+  void _print_json_string(const char* string);
 
   int baudrate;
 
+  int streamed_items;
+
+  // stage timing
+  unsigned long requests_count;
+  unsigned long parse_time_usec;
+  unsigned long send_time_usec;
+  unsigned long request_start_usec;
+  LatencyHistogram parse_histogram;
+  LatencyHistogram send_histogram;
+
+  // link counters
+  unsigned long link_bytes_received;
+  unsigned long link_bytes_sent;
+  unsigned long link_frames;
+  unsigned long link_parse_errors;
+  unsigned long link_overflows;
+  unsigned long link_flush_time_usec;
+
+  // memory peaks
+  size_t request_doc_peak_capacity;
+  size_t request_doc_peak_usage;
+  size_t message_peak_bytes;
+
   RpcProcessor rpc_processor_callback;
 
   char serial_read_buffer[_JSON_RPC_BUFFER_SIZE];
@@ -49,7 +172,12 @@ private:
 };
 
 SerialJsonRpcBoard::SerialJsonRpcBoard(RpcProcessor rpc_processor)
-  : rpc_processor_callback(rpc_processor), serial_read_buffer_pos(0) {}
+  : streamed_items(0),
+    requests_count(0), parse_time_usec(0), send_time_usec(0), request_start_usec(0),
+    link_bytes_received(0), link_bytes_sent(0), link_frames(0), link_parse_errors(0), link_overflows(0),
+    link_flush_time_usec(0),
+    request_doc_peak_capacity(0), request_doc_peak_usage(0), message_peak_bytes(0),
+    rpc_processor_callback(rpc_processor), serial_read_buffer_pos(0) {}
 
 void SerialJsonRpcBoard::init() {
   Serial.begin(_DEFAULT_BAUDRATE);
@@ -59,13 +187,30 @@ void SerialJsonRpcBoard::loop() {
   // read data by char if any
   while (Serial.available()) {
     char c = (char)Serial.read();
+    link_bytes_received++;
 
     if (c == _END_OF_JSON_RPC_MESSAGE) {
-      DynamicJsonDocument request(serial_read_buffer_pos);
+      STAGE_TRACE(RX_END, serial_read_buffer_pos);
+      link_frames++;
+      requests_count++;
+      if ((size_t)serial_read_buffer_pos > message_peak_bytes) {
+        message_peak_bytes = serial_read_buffer_pos;
+      }
+      request_start_usec = micros();
+      // zero-copy: the strings stay in the receive buffer, the document holds the values only
+      DynamicJsonDocument request(_request_capacity());
       DeserializationError deserialization_error = deserializeJson(request, serial_read_buffer, serial_read_buffer_pos);
+      if (request.capacity() > request_doc_peak_capacity) {
+        request_doc_peak_capacity = request.capacity();
+      }
+      if (request.memoryUsage() > request_doc_peak_usage) {
+        request_doc_peak_usage = request.memoryUsage();
+      }
       if (deserialization_error) {
-        const char* error_data = deserialization_error.c_str();
-        send_error(0, -32700, "Parse error", error_data);
+        _end_parse();
+        STAGE_TRACE(PARSE_ERROR, serial_read_buffer_pos);
+        link_parse_errors++;
+        send_error(0, -32700, PSTR("Parse error"), deserialization_error.c_str());
       } else {
         _process_request(request);
       }
@@ -77,68 +222,77 @@ void SerialJsonRpcBoard::loop() {
 
     // buffer overflow
     if (serial_read_buffer_pos >= _JSON_RPC_BUFFER_SIZE) {
-      send_error(0, -32600, "Invalid Request", "JSON RPC message is to large");
+      STAGE_TRACE(RX_OVERFLOW, _JSON_RPC_BUFFER_SIZE);
+      link_overflows++;
+      message_peak_bytes = _JSON_RPC_BUFFER_SIZE;
+      send_error_P(0, -32600, PSTR("Invalid Request"), PSTR("JSON RPC message is to large"));
       serial_read_buffer_pos = 0;
       return;
     }
 
     // read next char
+    if (serial_read_buffer_pos == 0) {
+      STAGE_TRACE(RX_BEGIN, 0);
+    }
     serial_read_buffer[serial_read_buffer_pos++] = c;
   }
 }
 
 void SerialJsonRpcBoard::send_result_string(int id, const char* string) {
-  // >"result":< == 9
-  // string len + "" (2)
-  int data_size = 9 + strlen(string) + 2;
-  DynamicJsonDocument response = _get_response(id, data_size);
-
-  DynamicJsonDocument result(data_size);
-  JsonVariant result_data = result.to<JsonVariant>();
-  result_data.set(String(string));
-  response["result"] = result_data;
-
-  _send_response(response);
+  const unsigned long start_usec = _begin_response(id);
+  _print_P(PSTR("\"result\":"));
+  _print_json_string(string);
+  _end_response(start_usec);
 }
 
-void SerialJsonRpcBoard::send_result_bytes(int id, uint8_t* buffer, int buffer_size) {
-  // >"result":< == 9
-  // max byte = 255 + comma separator + space == 4
-  // array braces = [] == 2
-  int data_size = 9 + 2 + 4 * buffer_size;
-  DynamicJsonDocument response = _get_response(id, data_size);
+void SerialJsonRpcBoard::send_result_string_P(int id, PGM_P format, ...) {
+  char buf[_MESSAGE_BUFFER_SIZE];
+  va_list args;
+  va_start(args, format);
+  vsnprintf_P(buf, sizeof(buf), format, args);
+  va_end(args);
+  send_result_string(id, buf);
+}
 
-  DynamicJsonDocument result(data_size);
-  JsonArray arr = result.to<JsonArray>();
-  for (int i = 0; i < buffer_size; i ++) {
-    arr.add(buffer[i]);
+void SerialJsonRpcBoard::send_result_bytes(int id, const uint8_t* buffer, int buffer_size) {
+  begin_result_array(id);
+  for (int i = 0; i < buffer_size; i++) {
+    add_result_array_int(buffer[i]);
   }
-  response["result"] = result;
+  end_result_array();
+}
 
-  _send_response(response);
+void SerialJsonRpcBoard::send_result_ints(int id, const int32_t* buffer, int buffer_size) {
+  begin_result_array(id);
+  for (int i = 0; i < buffer_size; i++) {
+    add_result_array_int(buffer[i]);
+  }
+  end_result_array();
 }
 
-void SerialJsonRpcBoard::send_result_ints(int id, int32_t* buffer, int buffer_size) {
-  // >"result":< == 9
-  // max byte = minus + 10 digits + comma separator + space == 13
-  // array braces = [] == 2
-  int data_size = 9 + 2 + 13 * buffer_size;
-  DynamicJsonDocument response = _get_response(id, data_size);
+void SerialJsonRpcBoard::begin_result_array(int id) {
+  const unsigned long start_usec = _begin_response(id);
+  _print_P(PSTR("\"result\":["));
+  streamed_items = 0;
+  // one send sample per response, taken at its end
+  send_time_usec += micros() - start_usec;
+}
 
-  DynamicJsonDocument result(data_size);
-  JsonArray arr = result.to<JsonArray>();
-  for (int i = 0; i < buffer_size; i ++) {
-    arr.add(buffer[i]);
+void SerialJsonRpcBoard::add_result_array_int(int32_t value) {
+  if (streamed_items > 0) {
+    link_bytes_sent += Serial.write(',');
   }
-  response["result"] = result;
+  link_bytes_sent += Serial.print(value);
+  streamed_items++;
+}
 
-  _send_response(response);
+void SerialJsonRpcBoard::end_result_array() {
+  const unsigned long start_usec = micros();
+  link_bytes_sent += Serial.write(']');
+  _end_response(start_usec);
 }
 
-static size_t SerialJsonRpcBoard::json_array_to_byte_array(const String& raw_json, uint8_t* byte_array, size_t array_size) {
-  DynamicJsonDocument json_doc(raw_json.length());
-  deserializeJson(json_doc, raw_json);
-  JsonArray json_array = json_doc.as<JsonArray>();
+size_t SerialJsonRpcBoard::json_array_to_byte_array(JsonArray json_array, uint8_t* byte_array, size_t array_size) {
   if (json_array.size() > array_size) {
     return -1;
   }
@@ -148,78 +302,135 @@ static size_t SerialJsonRpcBoard::json_array_to_byte_array(const String& raw_jso
   return json_array.size();
 }
 
-void SerialJsonRpcBoard::send_error(int id, int error_code, const char* error_message, const char* error_data) {
+void SerialJsonRpcBoard::send_error(int id, int error_code, PGM_P error_message, const char* error_data) {
   // {"jsonrpc":"2.0","id":-,"error":{"code":-,"message":"","data":""}}
-  // base lenght is 66
-  // +10 for ID (max signed 32 len)
-  // +10 for error_code
-  // 86 in total
-  DynamicJsonDocument response(86 + strlen(error_message) + strlen(error_data));
-  response["jsonrpc"] = "2.0";
-  response["id"] = id;
-
-  JsonObject error = response.createNestedObject("error");
-  error["code"] = error_code;
-  error["message"] = error_message;
+  const unsigned long start_usec = _begin_response(id);
+  _print_P(PSTR("\"error\":{\"code\":"));
+  link_bytes_sent += Serial.print(error_code);
+  _print_P(PSTR(",\"message\":\""));
+  _print_P(error_message);
+  link_bytes_sent += Serial.write('"');
   if (error_data != 0) {
-    error["data"] = error_data;
+    _print_P(PSTR(",\"data\":"));
+    _print_json_string(error_data);
   }
+  link_bytes_sent += Serial.write('}');
+  _end_response(start_usec);
+}
 
-  serializeJson(response, Serial);
-  response.clear();
-  response.garbageCollect();
+void SerialJsonRpcBoard::send_error_P(int id, int error_code, PGM_P error_message, PGM_P error_data_format, ...) {
+  char buf[_MESSAGE_BUFFER_SIZE];
+  va_list args;
+  va_start(args, error_data_format);
+  vsnprintf_P(buf, sizeof(buf), error_data_format, args);
+  va_end(args);
+  send_error(id, error_code, error_message, buf);
+}
 
-  Serial.write(_END_OF_JSON_RPC_MESSAGE);
-  Serial.flush();
+// every value but the first of a container follows a comma, so the values are at most
+// the commas plus the containers plus the root, a tight bound for long byte arrays
+size_t SerialJsonRpcBoard::_request_capacity() {
+  size_t slots = 1;
+  for (int i = 0; i < serial_read_buffer_pos; i++) {
+    const char c = serial_read_buffer[i];
+    if (c == ',' || c == '[' || c == '{') {
+      slots++;
+    }
+  }
+  return JSON_ARRAY_SIZE(slots);
 }
 
 void SerialJsonRpcBoard::_process_request(JsonDocument& request) {
   // validata JSON RPC format
-  if (!request.containsKey("jsonrpc") || strcmp(request["jsonrpc"], "2.0") != 0) {
-    send_error(0, -32600, "Invalid Request", "Invalid protocol version");
+  // a missing or non-string version is null
+  const char* jsonrpc = request["jsonrpc"] | "";
+  if (strcmp_P(jsonrpc, PSTR("2.0")) != 0) {
+    _end_parse();
+    STAGE_TRACE(PARSE_ERROR, 0);
+    link_parse_errors++;
+    send_error_P(0, -32600, PSTR("Invalid Request"), PSTR("Invalid protocol version"));
     return;
   }
 
   int request_id = request.containsKey("id") ? request["id"].as<int>() : 0;
 
-  const String method = request["method"] | "";
+  const char* method = request["method"] | "";
   JsonVariant params = request["params"];
 
   if (!params.is<JsonArray>()) {
-    send_error(request_id, -32602, "Invalid params", "Array expected");
+    _end_parse();
+    STAGE_TRACE(PARSE_ERROR, 0);
+    link_parse_errors++;
+    send_error_P(request_id, -32602, PSTR("Invalid params"), PSTR("Array expected"));
     return;
   }
 
-  // convert JsonArray to const String[]
-  JsonArray params_json_array = params.as<JsonArray>();
-  const size_t params_size = params_json_array.size();
-  const String params_array[params_size];
-  for (size_t i = 0; i < params_size; i++) {
-    params_array[i] = params_json_array[i].as<String>();
-  }
+  JsonArray params_array = params.as<JsonArray>();
+  _end_parse();
+  STAGE_TRACE(PARSE_END, params_array.size());
 
-  rpc_processor_callback(request_id, method, params_array, params_size);
+  rpc_processor_callback(request_id, method, params_array);
 }
 
-DynamicJsonDocument SerialJsonRpcBoard::_get_response(int id, int data_size) {
-  // {"jsonrpc":"2.0","id":}
-  // base lenght is 24
-  // +10 for ID (max signed 32 len)
-  // 34 in total
-  // +10 buffer
-  DynamicJsonDocument response(34 + data_size + 10);
-  response["jsonrpc"] = "2.0";
-  response["id"] = id;
-  return response;
+void SerialJsonRpcBoard::_end_parse() {
+  const unsigned long parse_usec = micros() - request_start_usec;
+  parse_time_usec += parse_usec;
+  parse_histogram.add(parse_usec);
 }
 
-void SerialJsonRpcBoard::_send_response(const DynamicJsonDocument &response) {
-  serializeJson(response, Serial);
-  response.clear();
-  response.garbageCollect();
+void SerialJsonRpcBoard::_end_send(const unsigned long start_usec) {
+  STAGE_TRACE(SEND_END, 0);
+  const unsigned long send_usec = micros() - start_usec;
+  send_time_usec += send_usec;
+  send_histogram.add(send_usec);
+}
 
-  Serial.write(_END_OF_JSON_RPC_MESSAGE);
+// blocks until the TX buffer is drained, the time tells how much the link holds the board back
+void SerialJsonRpcBoard::_flush() {
+  const unsigned long start_usec = micros();
   Serial.flush();
+  link_flush_time_usec += micros() - start_usec;
+}
+
+unsigned long SerialJsonRpcBoard::_begin_response(int id) {
+  STAGE_TRACE(SEND_BEGIN, 0);
+  const unsigned long start_usec = micros();
+  _print_P(PSTR("{\"jsonrpc\":\"2.0\",\"id\":"));
+  link_bytes_sent += Serial.print(id);
+  link_bytes_sent += Serial.write(',');
+  return start_usec;
+}
+
+void SerialJsonRpcBoard::_end_response(const unsigned long start_usec) {
+  link_bytes_sent += Serial.write('}');
+  link_bytes_sent += Serial.write(_END_OF_JSON_RPC_MESSAGE);
+  _flush();
+  _end_send(start_usec);
+}
+
+void SerialJsonRpcBoard::_print_P(PGM_P string) {
+  for (char c = pgm_read_byte(string); c != 0; c = pgm_read_byte(++string)) {
+    link_bytes_sent += Serial.write(c);
+  }
+}
+
+// quotes and escapes like serializeJson, the text may come from the request
+void SerialJsonRpcBoard::_print_json_string(const char* string) {
+  link_bytes_sent += Serial.write('"');
+  for (; *string != 0; string++) {
+    const char c = *string;
+    if (c == '"' || c == '\\') {
+      link_bytes_sent += Serial.write('\\');
+      link_bytes_sent += Serial.write(c);
+    } else if ((uint8_t)c < 0x20) {
+      char buf[7];
+      snprintf_P(buf, sizeof(buf), PSTR("\\u%04x"), (uint8_t)c);
+      link_bytes_sent += Serial.print(buf);
+    } else {
+      link_bytes_sent += Serial.write(c);
+    }
+  }
+  link_bytes_sent += Serial.write('"');
 }
 
 }
@@ -0,0 +1,115 @@
+#ifndef __stage_trace_h__
+#define __stage_trace_h__
+
+// Stage Trace
+// a ring buffer of (event, micros, arg) records in SRAM, emitted at the stage boundaries
+// of the rpc board and the programmer, `dump_trace` drains it
+//
+// off by default, define the depth before the includes of the sketch to turn it on:
+//   #define STAGE_TRACE_DEPTH 64
+// STAGE_TRACE_ARG_TYPE sets the arg width, uint16_t by default, a record is 7 bytes on AVR
+// with the depth 0 the STAGE_TRACE macro compiles to nothing
+
+#ifndef STAGE_TRACE_DEPTH
+#define STAGE_TRACE_DEPTH 0
+#endif
+
+#ifndef STAGE_TRACE_ARG_TYPE
+#define STAGE_TRACE_ARG_TYPE uint16_t
+#endif
+
+namespace StageTraceLibrary {
+
+// keep the ids stable, the client decodes them by value
+enum TraceEvent : uint8_t {
+  // serial json rpc board
+  RX_BEGIN = 1,       // first byte of a message
+  RX_END = 2,         // message terminator, arg: message bytes
+  RX_OVERFLOW = 3,    // message dropped, arg: buffer size
+  PARSE_END = 4,      // request converted, arg: params count
+  PARSE_ERROR = 5,    // request rejected, arg: message bytes, 0 for an invalid request
+  SEND_BEGIN = 6,     // response serialization
+  SEND_END = 7,       // Serial.flush() returned
+  // eeprom programmer
+  READ_PAGE_BEGIN = 20,   // arg: page no
+  READ_PAGE_END = 21,     // arg: error code
+  HASH_BEGIN = 22,        // arg: length
+  HASH_END = 23,          // arg: error code
+  WRITE_PAGE_BEGIN = 24,  // arg: page no
+  WRITE_PAGE_END = 25,    // arg: error code
+  WRITE_POLL_END = 26,    // end of the write-cycle wait of a byte, arg: wait usec
+};
+
+#if STAGE_TRACE_DEPTH > 0
+
+struct TraceRecord {
+  uint8_t event;
+  uint32_t micros_usec;
+  STAGE_TRACE_ARG_TYPE arg;
+};
+
+class StageTrace {
+public:
+  static const uint16_t DEPTH = STAGE_TRACE_DEPTH;
+
+  StageTrace()
+    : _head(0), _size(0), _dropped(0) {}
+
+  // overwrites the oldest record when full
+  void add(const uint8_t event, const uint32_t arg) {
+    TraceRecord& record = _records[_head];
+    record.event = event;
+    record.micros_usec = micros();
+    record.arg = (STAGE_TRACE_ARG_TYPE)arg;
+    _head = _head + 1 < DEPTH ? _head + 1 : 0;
+    if (_size < DEPTH) {
+      _size++;
+    } else {
+      _dropped++;
+    }
+  }
+
+  // oldest first
+  bool pop(TraceRecord& record) {
+    if (_size == 0) {
+      return false;
+    }
+    const uint16_t tail = _head >= _size ? _head - _size : _head + DEPTH - _size;
+    record = _records[tail];
+    _size--;
+    return true;
+  }
+
+  uint16_t size() const {
+    return _size;
+  }
+
+  // records overwritten since the last reset
+  uint32_t get_dropped() const {
+    return _dropped;
+  }
+  void reset_dropped() {
+    _dropped = 0;
+  }
+
+private:
+  TraceRecord _records[DEPTH];
+  uint16_t _head;
+  uint16_t _size;
+  uint32_t _dropped;
+};
+
+// one trace per firmware, the libraries and the sketch share it
+static StageTrace stage_trace;
+
+#define STAGE_TRACE(event, arg) StageTraceLibrary::stage_trace.add(StageTraceLibrary::TraceEvent::event, (arg))
+
+#else
+
+#define STAGE_TRACE(event, arg) ((void)0)
+
+#endif  // STAGE_TRACE_DEPTH > 0
+
+}  // StageTraceLibrary
+
+#endif  // !__stage_trace_h__
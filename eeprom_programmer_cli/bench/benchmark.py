@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+
+from typing import Any, Dict, List, Optional, Tuple
+
+import argparse
+import glob
+import json
+import os
+import sys
+import time
+
+from core.eeprom_programmer_client import EepromProgrammerClient
+from serial_json_rpc.client import SerialJsonRpcClient
+from sim.firmware_board import FirmwareBoard
+
+OPERATIONS = ("erase", "write", "read", "verify")
+CHIPS = ("AT28C64", "AT28C256", "AT28C16")
+STAGES = ("host_encode", "host_decode", "link", "board_parse", "bus_io", "write_wait")
+
+DEFAULT_IMAGES = "test_bin/*.bin"
+DEFAULT_TOLERANCE = 0.1
+
+# 8N1: a start bit, 8 data bits and a stop bit per byte
+_BITS_PER_BYTE = 10
+
+
+class BenchmarkError(Exception):
+    pass
+
+
+def run_operation(programmer: EepromProgrammerClient, operation: str, data: bytes) -> int:
+    memory_size = programmer.chip_settings["memory_size"]
+    if operation == "erase":
+        programmer.erase_data(0xFF)
+        return memory_size
+    if operation == "write":
+        programmer.write_data(data)
+        return len(data)
+    if operation == "read":
+        programmer.read_data()
+        return memory_size
+    if operation == "verify":
+        mismatched_pages = programmer.verify_data(data)
+        if mismatched_pages:
+            raise BenchmarkError(f"verify failed, {len(mismatched_pages)} pages differ")
+        return len(data)
+    raise BenchmarkError(f"unknown operation: {operation}")
+
+
+def measure(programmer: EepromProgrammerClient, operation: str, data: bytes, baudrate: int) -> Dict[str, Any]:
+    json_rpc_client = programmer.json_rpc_client
+    programmer.reset_stage_times()
+    json_rpc_client.reset_stats()
+
+    start_ts = time.perf_counter()
+    size = run_operation(programmer, operation, data)
+    wall_time_sec = time.perf_counter() - start_ts
+
+    transport = json_rpc_client.stats
+    board = programmer.get_stage_times()
+    stages = {
+        "host_encode": transport.encode_time_sec,
+        "host_decode": transport.decode_time_sec,
+        "link": (transport.bytes_sent + transport.bytes_received) * _BITS_PER_BYTE / baudrate,
+        "board_parse": board["parse_usec"] / 1e6,
+        "bus_io": board["bus_io_usec"] / 1e6,
+        "write_wait": board["write_wait_usec"] / 1e6,
+    }
+    # round-trip latency, idle gaps and the board send time beyond the link
+    stages["other"] = wall_time_sec - sum(stages.values())
+
+    return {
+        "bytes": size,
+        "wall_time_sec": round(wall_time_sec, 3),
+        "bytes_per_sec": round(size / wall_time_sec, 1),
+        "requests": transport.requests,
+        "wire_bytes": transport.bytes_sent + transport.bytes_received,
+        "stages_sec": {stage: round(sec, 4) for stage, sec in stages.items()},
+    }
+
+
+def run_chip(port: str, chip: str, images: List[str], operations: List[str], baudrate: int, init_timeout: float,
+             pipeline_depth: int) -> List[Dict[str, Any]]:
+    json_rpc_client = SerialJsonRpcClient(port=port, baudrate=baudrate, init_timeout=init_timeout)
+    json_rpc_client.init()
+    programmer = EepromProgrammerClient(json_rpc_client, pipeline_depth, log=lambda message: None)
+    programmer.init_chip(chip)
+    memory_size = programmer.chip_settings["memory_size"]
+
+    results = []
+    for image in images:
+        with open(image, "rb") as f:
+            data = f.read()
+        if len(data) > memory_size:
+            continue
+        for operation in operations:
+            result = {
+                "key": f"{chip}/{os.path.basename(image)}/{operation}",
+                "chip": chip,
+                "image": os.path.basename(image),
+                "operation": operation,
+                "baudrate": baudrate,
+                "pipeline_depth": pipeline_depth,
+            }
+            result.update(measure(programmer, operation, data, baudrate))
+            print_result(result)
+            results.append(result)
+    return results
+
+
+def print_result(result: Dict[str, Any]):
+    wall_time_sec = result["wall_time_sec"]
+    shares = " ".join(
+        f"{stage} {100.0 * sec / wall_time_sec:3.0f}%" for stage, sec in result["stages_sec"].items())
+    print(f"{result['key']:<48} {result['bytes']:6d} B {wall_time_sec:8.2f} s {result['bytes_per_sec']:8.1f} B/s  {shares}",
+          flush=True)
+
+
+# the throughput depends on the link and the requests in flight as much as on the chip and the image
+COMPARE_FIELDS = ("chip", "image", "operation", "baudrate", "pipeline_depth")
+
+
+def compare_key(entry: Dict[str, Any]) -> Tuple[Any, ...]:
+    return tuple(entry.get(field) for field in COMPARE_FIELDS)
+
+
+def compare(results: List[Dict[str, Any]], baseline: List[Dict[str, Any]], tolerance: float) -> Tuple[List[str], List[str]]:
+    """
+    returns the keys of the regressions and of the baseline entries this run did not measure
+    """
+    baseline_by_key = {compare_key(entry): entry for entry in baseline}
+    regressions = []
+    for result in results:
+        entry = baseline_by_key.pop(compare_key(result), None)
+        if entry is None:
+            print(f"{result['key']:<48} no baseline at {result['baudrate']} baud, pipeline depth {result['pipeline_depth']}")
+            continue
+        ratio = result["bytes_per_sec"] / entry["bytes_per_sec"]
+        status = "ok"
+        if ratio < 1.0 - tolerance:
+            status = "REGRESSION"
+            regressions.append(result["key"])
+        print(f"{result['key']:<48} {entry['bytes_per_sec']:8.1f} -> {result['bytes_per_sec']:8.1f} B/s "
+              f"{100.0 * (ratio - 1.0):+6.1f}%  {status}")
+    unmeasured = []
+    for entry in baseline_by_key.values():
+        print(f"{entry['key']:<48} NOT MEASURED at {entry['baudrate']} baud, pipeline depth {entry['pipeline_depth']}")
+        unmeasured.append(entry["key"])
+    return regressions, unmeasured
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Measure read, erase, write and verify throughput with a per-stage time split")
+    parser.add_argument("--port", type=str, default=None, metavar="<port>",
+                        help="Real board port, default: the host firmware build on a pty")
+    parser.add_argument("--binary", type=str, default=FirmwareBoard.DEFAULT_BINARY, metavar="<path>",
+                        help=f"Host firmware binary, default: {FirmwareBoard.DEFAULT_BINARY}")
+    parser.add_argument("--chip", type=str, action="append", default=None, metavar="<chip>",
+                        help=f"Chips to measure, default: {', '.join(CHIPS)}, a real board measures the chip in its socket")
+    parser.add_argument("--image", type=str, action="append", default=None, metavar="<filename>",
+                        help=f"Images to write, default: {DEFAULT_IMAGES}, images bigger than the chip are skipped")
+    parser.add_argument("--operation", type=str, action="append", default=None, choices=OPERATIONS,
+                        help=f"Operations in order, default: {', '.join(OPERATIONS)}")
+    parser.add_argument("--baudrate", type=int, default=115200,
+                        help="Serial baudrate, the simulated link runs at the same rate, default: 115200")
+    parser.add_argument("--pipeline-depth", type=int, default=EepromProgrammerClient.DEFAULT_PIPELINE_DEPTH, metavar="<n>",
+                        help=f"Requests in flight, default: {EepromProgrammerClient.DEFAULT_PIPELINE_DEPTH}")
+    parser.add_argument("--json", type=str, default=None, metavar="<filename>",
+                        help="Write the results as JSON, the file can be a baseline for later runs")
+    parser.add_argument("--baseline", type=str, default=None, metavar="<filename>",
+                        help="Compare the throughput with the results of an earlier run")
+    parser.add_argument("--tolerance", type=float, default=DEFAULT_TOLERANCE, metavar="<ratio>",
+                        help=f"Allowed throughput drop against the baseline, default: {DEFAULT_TOLERANCE}")
+    parser.add_argument("--strict", action="store_true",
+                        help="Fail when a baseline entry has no result, e.g. a chip, image, baudrate or pipeline depth left out")
+    args = parser.parse_args()
+
+    chips = args.chip or list(CHIPS)
+    images = args.image or sorted(glob.glob(DEFAULT_IMAGES))
+    operations = args.operation or list(OPERATIONS)
+    if args.port is not None and len(chips) != 1:
+        print("a real board needs exactly one --chip", file=sys.stderr)
+        sys.exit(2)
+
+    results = []
+    for chip in chips:
+        if args.port is not None:
+            results += run_chip(args.port, chip, images, operations, args.baudrate, 3.0, args.pipeline_depth)
+            continue
+        # the board sleeps through the virtual write cycles, so the wall time matches a real board
+        board = FirmwareBoard(args.binary, chip, args.baudrate, firmware_args=["--realtime"])
+        port = board.start()
+        try:
+            results += run_chip(port, chip, images, operations, args.baudrate, 0.0, args.pipeline_depth)
+        finally:
+            board.stop()
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2)
+
+    if args.baseline:
+        with open(args.baseline, "r") as f:
+            baseline = json.load(f)
+        regressions, unmeasured = compare(results, baseline, args.tolerance)
+        if unmeasured:
+            print(f"{len(unmeasured)} baseline entries not measured")
+        if regressions:
+            print(f"{len(regressions)} throughput regressions over {100.0 * args.tolerance:.0f}%")
+        if regressions or (unmeasured and args.strict):
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,19 +1,39 @@
 #!/usr/bin/env python3
 
+from typing import Dict, List, Optional
+
 import argparse
+import contextlib
+import glob
+import os
 import sys
+import threading
 import time
 
 from core.eeprom_programmer_client import EepromProgrammerClient
+from core.image_formats import SparseImage, load_image
 from serial_json_rpc.client import SerialJsonRpcClient
+from serial_json_rpc.request_recorder import RequestRecorder
 
 
 class CliError(Exception):
     pass
 
 
-def connect_programmer(port: str, baudrate: int, init_timeout: int):
-    print(f"connect programmer: {port}")
+# gang mode prefixes every line with the board port
+_log_context = threading.local()
+# print writes the newline apart, the lines of the boards would interleave
+_log_lock = threading.Lock()
+
+
+def log(message: str):
+    prefix = getattr(_log_context, "prefix", "")
+    with _log_lock:
+        print(f"{prefix}{message}", flush=True)
+
+
+def connect_programmer(port: str, baudrate: int, init_timeout: int, pipeline_depth: int):
+    log(f"connect programmer: {port}")
 
     ts = time.time()
 
@@ -22,33 +42,33 @@ def connect_programmer(port: str, baudrate: int, init_timeout: int):
 
     init_result = json_rpc_client.init()
     if init_result is not None:
-        print(f"connect programmer: response {init_result}")
+        log(f"connect programmer: response {init_result}")
 
     elapsed = time.time() - ts
-    print(f"connect programmer: DONE, {elapsed:.02f} sec")
+    log(f"connect programmer: DONE, {elapsed:.02f} sec")
 
     programmer = EepromProgrammerClient(
-        json_rpc_client)
+        json_rpc_client, pipeline_depth, log)
 
     return programmer
 
 
 def init_device(programmer: EepromProgrammerClient, device: str):
-    print(f"init device: {device}")
+    log(f"init device: {device}")
 
     try:
         programmer.init_chip(device)
     except Exception as ex:
         raise CliError(f"init device: failed, {str(ex)}")
 
-    print(f"init device: DONE")
+    log(f"init device: DONE")
 
 
 def read(programmer: EepromProgrammerClient, filename: str):
     if not filename:
         raise CliError("filename is empty")
 
-    print(f"read operation: {filename}")
+    log(f"read operation: {filename}")
 
     ts = time.time()
 
@@ -61,81 +81,130 @@ def read(programmer: EepromProgrammerClient, filename: str):
         f.write(output_data)
 
     elapsed = time.time() - ts
-    print(f"read operation: DONE, {elapsed:.02f} sec")
-
+    log(f"read operation: DONE, {elapsed:.02f} sec")
 
-def write(programmer: EepromProgrammerClient, filename: str, erase_pattern_str: str, skip_erase: bool, collect_write_performance: bool):
-    print(f"write operation: {filename}")
 
+def load_input_image(programmer: EepromProgrammerClient, filename: str) -> SparseImage:
     if not filename:
         raise CliError("filename is empty")
 
-    input_data = None
-    with open(filename, "rb") as f:
-        input_data = bytes(f.read())
-    if not input_data:
+    # .bin is a flat image, Intel HEX and S-record files are sparse ranges
+    try:
+        image = load_image(filename)
+    except Exception as ex:
+        raise CliError(f"failed to load {filename}, {str(ex)}")
+    if not image.size:
         raise CliError("data source is empty")
 
     memory_size = programmer.chip_settings["memory_size"]
-    if len(input_data) > memory_size:
+    if image.end_address > memory_size:
         raise CliError("data size is bigger than the chip memory size")
-    if len(input_data) < memory_size:
-        print(
-            f"WARNING incorrect data size: {len(input_data)} / chip memory size is {memory_size}")
 
-    if not skip_erase:
-        erase(programmer, erase_pattern_str, collect_write_performance)
+    return image
+
 
-    print("write operation: started")
+def write_sparse(programmer: EepromProgrammerClient, image: SparseImage, collect_write_performance: bool):
+    # pages outside the ranges keep their content, so there is no erase
+    log(f"write operation: started, {image.size} bytes in {len(image.ranges)} ranges")
 
     ts = time.time()
 
     try:
-        programmer.write_data(input_data, collect_write_performance)
+        programmer.write_sparse(image, collect_write_performance)
     except Exception as ex:
         raise CliError(f"write operation: failed, {str(ex)}")
 
     elapsed = time.time() - ts
-    print(f"write operation: DONE, {elapsed:.02f} sec")
+    log(f"write operation: DONE, {elapsed:.02f} sec")
 
 
-def verify(programmer: EepromProgrammerClient, filename: str):
-    print(f"verify operation: {filename}")
+def write(programmer: EepromProgrammerClient, filename: str, erase_pattern_str: str, skip_erase: bool, collect_write_performance: bool,
+          delta: bool, resume: bool):
+    log(f"write operation: {filename}")
 
-    if not filename:
-        raise CliError("filename is empty")
-
-    input_data = None
-    with open(filename, "rb") as f:
-        input_data = bytes(f.read())
-    if not input_data:
-        raise CliError("data source is empty")
+    image = load_input_image(programmer, filename)
+    if image.sparse:
+        if delta or resume:
+            raise CliError("--delta and --resume are supported for binary images only")
+        write_sparse(programmer, image, collect_write_performance)
+        return
 
+    input_data = image.flat_data()
     memory_size = programmer.chip_settings["memory_size"]
-    if len(input_data) > memory_size:
-        raise CliError("data size is bigger than the chip memory size")
     if len(input_data) < memory_size:
+        log(
+            f"WARNING incorrect data size: {len(input_data)} / chip memory size is {memory_size}")
+
+    # the journal next to the image tracks the last page confirmed by the board
+    journal = programmer.write_journal(filename, input_data)
+    start_page = 0
+    if resume:
+        if not journal.exists():
+            raise CliError(f"write operation: nothing to resume, {journal.path} not found")
+        try:
+            journal.load()
+            start_page = programmer.resume_page(journal, input_data)
+        except Exception as ex:
+            raise CliError(f"write operation: failed to resume, {str(ex)}")
+        log(f"write operation: resume from page {start_page}")
+    else:
+        # a fresh write starts the journal over before the erase, the last page of an earlier
+        # run would resume above the pages a failed erase left blank
+        journal.save()
+        # delta writes compare against the current chip content, erase would defeat them
+        # resumed writes have been erased by the interrupted run
+        if not skip_erase and not delta:
+            with timeline_span(programmer, "erase"):
+                erase(programmer, erase_pattern_str, collect_write_performance)
+
+    log("write operation: started")
+
+    ts = time.time()
+
+    try:
+        journal.save()
+        programmer.write_data(input_data, collect_write_performance, delta, journal, start_page)
+    except Exception as ex:
+        raise CliError(f"write operation: failed, {str(ex)}, resume with --resume")
+
+    journal.remove()
+
+    elapsed = time.time() - ts
+    log(f"write operation: DONE, {elapsed:.02f} sec")
+
+
+def verify(programmer: EepromProgrammerClient, filename: str, hash_algorithm: str):
+    log(f"verify operation: {filename}")
+
+    image = load_input_image(programmer, filename)
+
+    # sparse images are verified within their ranges only
+    memory_size = programmer.chip_settings["memory_size"]
+    if not image.sparse and image.size < memory_size:
         raise CliError(
-            f"incorrect data size: {len(input_data)} / chip memory size is {memory_size}")
+            f"incorrect data size: {image.size} / chip memory size is {memory_size}")
 
-    print("read operation: started")
+    log(f"verify operation: started, {hash_algorithm} on the board")
 
     ts = time.time()
 
     try:
-        output_data = programmer.read_data()
+        if image.sparse:
+            mismatched_pages = programmer.verify_sparse(image, hash_algorithm)
+        else:
+            mismatched_pages = programmer.verify_data(image.flat_data(), hash_algorithm)
     except Exception as ex:
-        raise CliError(f"read operation: failed, {str(ex)}")
-    
-    if input_data != output_data:
-        raise CliError(f"verify operation: failed, mismatched data")
+        raise CliError(f"verify operation: failed, {str(ex)}")
+
+    if mismatched_pages:
+        raise CliError(f"verify operation: failed, mismatched pages {mismatched_pages}")
 
     elapsed = time.time() - ts
-    print(f"verify operation: DONE, {elapsed:.02f} sec")
+    log(f"verify operation: DONE, {elapsed:.02f} sec")
 
 
 def erase(programmer: EepromProgrammerClient, erase_pattern_str: str, collect_write_performance: bool):
-    print("erase operation")
+    log("erase operation")
 
     erase_pattern = 255  # FF
     if erase_pattern_str:
@@ -148,7 +217,7 @@ def erase(programmer: EepromProgrammerClient, erase_pattern_str: str, collect_wr
             raise CliError(
                 f"invalid erase pattern {erase_pattern_str}, should be a HEX value")
 
-    print(f"erase pattern: 0x{erase_pattern:02X}")
+    log(f"erase pattern: 0x{erase_pattern:02X}")
 
     ts = time.time()
 
@@ -158,17 +227,235 @@ def erase(programmer: EepromProgrammerClient, erase_pattern_str: str, collect_wr
         raise CliError(f"erase operation: failed, {str(ex)}")
 
     elapsed = time.time() - ts
-    print(f"erase operation: DONE, {elapsed:.02f} sec")
+    log(f"erase operation: DONE, {elapsed:.02f} sec")
+
+
+def run_operation(args: argparse.Namespace, port: str):
+    # connect
+    programmer = connect_programmer(
+        port, args.baudrate, args.init_timeout, args.pipeline_depth)
+
+    # init chip
+    init_device(programmer, args.device)
+
+    link_before = link_stats(programmer)
+    ts = time.time()
+
+    operation = ("read" if args.read is not None else "write" if args.write is not None
+                 else "verify" if args.verify is not None else "erase" if args.erase else None)
+    if operation is None:
+        raise CliError("unknown operation")
+
+    recorder = None
+    if args.timeline is not None:
+        recorder = RequestRecorder(f"{operation} {port}")
+        programmer.json_rpc_client.recorder = recorder
+
+    try:
+        with timeline_span(programmer, operation):
+            if args.read is not None:
+                read(programmer, args.read)
+
+            elif args.write is not None:
+                write(programmer, args.write, args.erase_pattern, args.skip_erase,
+                      args.collect_write_performance, args.delta, args.resume)
+
+            elif args.verify is not None:
+                verify(programmer, args.verify, args.hash_algorithm)
+
+            else:
+                erase(programmer, args.erase_pattern, args.collect_write_performance)
+    finally:
+        # a failed operation keeps its timeline, the last requests show where it stalled
+        if recorder is not None:
+            programmer.json_rpc_client.recorder = None
+            save_timeline(recorder, args.timeline, operation, port)
+
+    link_utilization(programmer, link_before, time.time() - ts, args.baudrate)
+
+    if args.stats:
+        board_stats(programmer)
+
+    if args.trace:
+        board_trace(programmer)
+
+    if args.memory:
+        board_memory(programmer)
+
+
+@contextlib.contextmanager
+def timeline_span(programmer: EepromProgrammerClient, name: str):
+    recorder = programmer.json_rpc_client.recorder
+    if recorder is None:
+        yield
+        return
+    recorder.begin_operation(name)
+    try:
+        yield
+    finally:
+        recorder.end_operation()
+
+
+def save_timeline(recorder: RequestRecorder, timeline_dir: str, operation: str, port: str):
+    os.makedirs(timeline_dir, exist_ok=True)
+    # one file per operation and board, the msec keep back-to-back runs apart
+    ts = time.time()
+    filename = os.path.join(
+        timeline_dir, f"{operation}_{os.path.basename(port)}_{time.strftime('%Y%m%d_%H%M%S', time.localtime(ts))}_{int(ts * 1000) % 1000:03d}.json")
+    try:
+        recorder.save_chrome_trace(filename)
+    except OSError as ex:
+        raise CliError(f"timeline: failed to save {filename}, {str(ex)}")
+    log(f"timeline: {filename}, {len(recorder.completed())} requests, {recorder.idle_sec():.2f} sec idle")
+    for method, summary in recorder.method_summary().items():
+        log(f"timeline: {method}: n {summary['count']}, p50 {summary['p50_ms']:.2f} ms, p90 {summary['p90_ms']:.2f} ms, "
+            f"p99 {summary['p99_ms']:.2f} ms, max {summary['max_ms']:.2f} ms, "
+            f"first byte p50 {summary['first_byte_p50_ms']:.2f} ms, "
+            f"{summary['request_bytes']:.0f} B out, {summary['response_bytes']:.0f} B in"
+            + (f", {summary['errors']} errors" if summary['errors'] else ""))
+
+
+def link_stats(programmer: EepromProgrammerClient) -> Optional[Dict[str, int]]:
+    # older firmware has no link counters, the operation runs without the report
+    try:
+        return programmer.get_link_stats()
+    except Exception:
+        return None
+
+
+_BITS_PER_BYTE = 10  # 8N1
+
+
+def link_utilization(programmer: EepromProgrammerClient, link_before: Optional[Dict[str, int]], elapsed: float, baudrate: int):
+    # payload bytes/s of each direction against the line rate, close to 100% means link-bound
+    link_after = link_stats(programmer)
+    if link_before is None or link_after is None or elapsed <= 0:
+        return
+    link = {name: (link_after[name] - link_before[name]) & 0xFFFFFFFF for name in link_after}
+    line_rate = baudrate / _BITS_PER_BYTE
+    # the board receives what the host sends
+    to_board = link["bytes_received"] / elapsed
+    to_host = link["bytes_sent"] / elapsed
+    log(f"link: host->board {to_board:.0f} B/s ({to_board / line_rate:.0%}), "
+        f"board->host {to_host:.0f} B/s ({to_host / line_rate:.0%}) of {line_rate:.0f} B/s, "
+        f"flush {link['flush_usec'] / 1e6:.2f} sec, {link['frames']} frames, "
+        f"{link['parse_errors']} parse errors, {link['overflows']} overflows")
+
+
+def board_stats(programmer: EepromProgrammerClient):
+    # the board resets on connect, so the stats cover this session
+    try:
+        stats = programmer.get_stats()
+    except Exception as ex:
+        raise CliError(f"board stats: failed, {str(ex)}")
+    for name, histogram in stats.items():
+        # a polled write-cycle wait is not a capture measurement
+        if name == "write_wait":
+            name = f"write_wait ({programmer.write_timing()})"
+        log(f"board stats: {name}: {histogram.summary()}")
+
+
+def board_trace(programmer: EepromProgrammerClient):
+    # the ring keeps the last records of the session, the oldest ones are dropped
+    try:
+        depth, dropped, records = programmer.dump_trace()
+    except Exception as ex:
+        raise CliError(f"board trace: failed, {str(ex)}")
+    if depth == 0:
+        log("board trace: the firmware is built without STAGE_TRACE_DEPTH")
+        return
+    log(f"board trace: {len(records)} records, {dropped} dropped, depth {depth}")
+    prev_micros = records[0][1] if records else 0
+    for event, micros, arg in records:
+        # micros() wraps after 71 minutes
+        log(f"board trace: {micros:>10} +{(micros - prev_micros) & 0xFFFFFFFF:>6} us {event} {arg}")
+        prev_micros = micros
+
+
+def board_memory(programmer: EepromProgrammerClient):
+    # the board resets on connect, so the peaks cover this session
+    try:
+        memory = programmer.get_memory()
+    except Exception as ex:
+        raise CliError(f"board memory: failed, {str(ex)}")
+    # the firmware sends -1 for the SRAM figures it cannot measure
+    if memory["static_bytes"] < 0:
+        log("board memory: SRAM figures unsupported (host build)")
+    else:
+        log(f"board memory: static {memory['static_bytes']} B, free heap {memory['free_heap_bytes']} B, "
+            f"largest free block {memory['largest_free_block_bytes']} B, stack peak {memory['stack_peak_bytes']} B, "
+            f"stack headroom {memory['stack_headroom_bytes']} B")
+    log(f"board memory: request document peak {memory['request_doc_peak_usage']} of "
+        f"{memory['request_doc_peak_capacity']} B, message peak {memory['message_peak_bytes']} B")
+
+
+def expand_ports(port_patterns: List[str]) -> List[str]:
+    ports = []
+    for pattern in port_patterns:
+        matches = sorted(glob.glob(pattern)) if glob.has_magic(pattern) else [pattern]
+        if not matches:
+            raise CliError(f"no ports match {pattern}")
+        for port in matches:
+            if port not in ports:
+                ports.append(port)
+    return ports
+
+
+def gang(args: argparse.Namespace, ports: List[str]):
+    if args.read is not None:
+        raise CliError("read operation is not supported in gang mode")
+
+    log(f"gang operation: {len(ports)} boards")
+
+    ts = time.time()
+
+    # one programmer per port, a failed board does not stop the healthy ones
+    results = {}
+
+    def run_board(port: str):
+        _log_context.prefix = f"[{port}] "
+        board_ts = time.time()
+        error = None
+        try:
+            run_operation(args, port)
+        except Exception as ex:
+            error = str(ex)
+            log(f"FAILED, {error}")
+        results[port] = (time.time() - board_ts, error)
+
+    threads = [threading.Thread(target=run_board, args=(port,)) for port in ports]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    elapsed = time.time() - ts
+
+    failed = 0
+    for port in ports:
+        board_elapsed, error = results[port]
+        if error is None:
+            log(f"gang operation: {port} OK, {board_elapsed:.02f} sec")
+        else:
+            failed += 1
+            log(f"gang operation: {port} FAILED, {board_elapsed:.02f} sec, {error}")
+
+    if failed:
+        raise CliError(f"gang operation: failed, {failed} of {len(ports)} boards, {elapsed:.02f} sec")
+
+    log(f"gang operation: DONE, {elapsed:.02f} sec")
 
 
 def cli() -> int:
     parser = argparse.ArgumentParser()
-    parser.add_argument("port", type=str, metavar="<port>",
-                        help="Specify the USP port address for the serial connection")
+    parser.add_argument("port", type=str, nargs="+", metavar="<port>",
+                        help="Specify the USP port address for the serial connection, several ports or a glob run the gang mode")
     parser.add_argument("--baudrate", type=int, default=115200,
                         metavar="<baud>", help="Set the serial connection speed")
     parser.add_argument("--init-timeout", type=int, default=3, metavar="<sec>",
                         help="Set the MAX Arduino's reset-on-connect timeout in seconds")
+    parser.add_argument("--pipeline-depth", type=int, default=EepromProgrammerClient.DEFAULT_PIPELINE_DEPTH, metavar="<n>",
+                        help="Keep up to <n> requests in flight during read and write, default: 1")
     parser.add_argument("-l", "--list", action="store_true",
                         help="List all supported devices")
     parser.add_argument("-p", "--device", type=str, required=False,
@@ -177,17 +464,31 @@ def cli() -> int:
                         help="Read from the device and write the contents to this file")
     parser.add_argument("-m", "--verify", type=str, required=False,
                         metavar="<filename>", help="Verify memory in the device against this file")
+    parser.add_argument("--hash-algorithm", type=str, default="crc32", choices=EepromProgrammerClient.HASH_ALGORITHMS,
+                        help="Range hash computed on the board during verify, default: crc32")
     parser.add_argument("-w", "--write", type=str, required=False,
-                        metavar="<filename>", help="Write to the device using this file")
+                        metavar="<filename>", help="Write to the device using this file: .bin, Intel HEX (.hex) or S-record (.srec, .s19)")
     parser.add_argument("-e", "--skip-erase",
                         action="store_true", help="Do NOT erase the device")
+    parser.add_argument("--delta", action="store_true",
+                        help="Write only the pages whose on-chip CRC differs from the file, implies --skip-erase")
+    parser.add_argument("--resume", action="store_true",
+                        help="Continue an interrupted write from its journal, re-checks the last written pages")
     # parser.add_argument("-v", "--skip_verify", action="store_true", help="Do NOT verify after write")
     parser.add_argument("-E", "--erase", action="store_true",
                         help="Just erase the device")
     parser.add_argument("--erase-pattern", type=str, required=False, metavar="<hex>",
                         help="Specify the erase pattern, like CC or AA, default: FF")
     parser.add_argument("--collect-write-performance", action="store_true",
-                        help="Collect the write operation performance")
+                        help="Report the write-cycle wait percentiles of the write operation")
+    parser.add_argument("--stats", action="store_true",
+                        help="Report the board latency percentiles of the session: write-cycle wait, bus read per page, request parse, response send")
+    parser.add_argument("--trace", action="store_true",
+                        help="Print the last stage trace records of the board, the firmware must be built with STAGE_TRACE_DEPTH")
+    parser.add_argument("--memory", action="store_true",
+                        help="Report the board SRAM use of the session: free heap, largest free block, stack peak, request document and message peaks")
+    parser.add_argument("--timeline", type=str, required=False, metavar="<dir>",
+                        help="Record every request of the operation into a Chrome/Perfetto trace in <dir> and report the latency per method")
     args = parser.parse_args()
 
     if args.list:
@@ -196,28 +497,11 @@ def cli() -> int:
     if not args.device:
         raise CliError("-p/--device argument is required")
 
-    # connect
-    programmer = connect_programmer(
-        args.port, args.baudrate, args.init_timeout)
-
-    # init chip
-    init_device(programmer, args.device)
-
-    if args.read is not None:
-        read(programmer, args.read)
-
-    elif args.write is not None:
-        write(programmer, args.write, args.erase_pattern, args.skip_erase,
-              args.collect_write_performance)
-
-    elif args.verify is not None:
-        verify(programmer, args.verify)
-
-    elif args.erase:
-        erase(programmer, args.erase_pattern, args.collect_write_performance)
-
+    ports = expand_ports(args.port)
+    if len(ports) == 1:
+        run_operation(args, ports[0])
     else:
-        raise CliError("unknown operation")
+        gang(args, ports)
 
 
 if __name__ == '__main__':
@@ -1,6 +1,15 @@
-from typing import List
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+import asyncio
+import binascii
+import zlib
 
 from serial_json_rpc import client
+from serial_json_rpc.async_client import AsyncSerialJsonRpcClient
+
+from core.image_formats import SparseImage
+from core.latency_histogram import LatencyHistogram
+from core.write_journal import WriteJournal
 
 
 class EepromProgrammerClientError(Exception):
@@ -8,11 +17,42 @@ class EepromProgrammerClientError(Exception):
 
 
 class EepromProgrammerClient:
-    _READ_PAGE_SIZE = 64
-    _WRITE_PAGE_SIZE = 64
+    # bytes per read_page/write_page request, bounded by the `max_page_size` of the board:
+    # a 128 bytes write_page is about 580 bytes on the wire, the board buffers 600
+    _READ_PAGE_SIZE = 128
+    _WRITE_PAGE_SIZE = 128
+
+    # pages re-checked on the chip before a write resumes
+    RESUME_RECHECK_PAGES = 4
+
+    HASH_ALGORITHMS = ("crc32", "crc16", "sum8", "sum16")
 
-    def __init__(self, json_rpc_client: client.SerialJsonRpcClient):
+    # the board hashes byte by byte through the bus, worst case per byte
+    _HASH_BYTE_TIME_SEC = 0.0002
+
+    # requests in flight; the board receives into a 64 bytes UART buffer
+    # while it is busy with a page, so deep pipelines work for reads only
+    DEFAULT_PIPELINE_DEPTH = 1
+    # the board writes one page and holds one more, a third one fails with WRITE_IN_PROGRESS
+    WRITE_PIPELINE_DEPTH = 2
+    # write progress lines per write, a gang write reports every board on the way
+    WRITE_PROGRESS_STEPS = 4
+
+    def __init__(self, json_rpc_client: client.SerialJsonRpcClient, pipeline_depth: int = DEFAULT_PIPELINE_DEPTH,
+                 log: Callable[[str], None] = print):
+        if pipeline_depth < 1:
+            raise EepromProgrammerClientError(
+                f"invalid pipeline depth: {pipeline_depth}")
         self.json_rpc_client = json_rpc_client
+        self.pipeline_depth = pipeline_depth
+        self.log = log
+
+    # order of the chip descriptor fields after the memory and max page sizes in the `init_chip` result
+    CHIP_DESCRIPTOR = ("write_page_size", "write_cycle_max_usec", "write_completion", "features", "write_timing")
+    # `write_timing`: how the board times the end of the write cycle
+    WRITE_TIMINGS = ("polling", "interrupt", "capture")
+    # `write_completion` of EPROMs like the 2716
+    WRITE_COMPLETION_READ_ONLY = 4
 
     def init_chip(self, chip_type: str):
         try:
@@ -23,68 +63,267 @@ class EepromProgrammerClient:
         if not chip_settings:
             raise EepromProgrammerClientError(
                 f"empty chip settings for {chip_type}")
+        self.chip_type = chip_type.upper()
         self.chip_settings = {
             "memory_size": chip_settings[0],
             "max_page_size": chip_settings[1],
         }
-        print(f"chip settings: {self.chip_settings}")
+        # the chip descriptor, older firmware does not send it
+        self.chip_settings.update(zip(self.CHIP_DESCRIPTOR, chip_settings[2:]))
+        # older firmware takes 64 bytes pages
+        self.read_page_size = min(self._READ_PAGE_SIZE, self.chip_settings["max_page_size"])
+        self.write_page_size = min(self._WRITE_PAGE_SIZE, self.chip_settings["max_page_size"])
+        self.log(f"chip settings: {self.chip_settings}")
+
+    def write_timing(self) -> str:
+        # older firmware and the fake board do not report it
+        timing = self.chip_settings.get("write_timing")
+        if timing is None or not 0 <= timing < len(self.WRITE_TIMINGS):
+            return "timing unknown"
+        return self.WRITE_TIMINGS[timing]
 
     def _set_read_mode(self, page_size: int):
         try:
             res = self.json_rpc_client.send_request("set_read_mode", [page_size])
-            print(f"set_read_mode: {res}")
+            self.log(f"set_read_mode: {res}")
         except Exception as ex:
             raise EepromProgrammerClientError(
                 f"failed to set READ mode with: {ex}")
 
     def read_data(self) -> bytes:
-        page_size = self._READ_PAGE_SIZE
+        page_size = self.read_page_size
         memory_size = self.chip_settings["memory_size"]
         pages_total = int(memory_size / page_size)
 
         # set READ mode
         self._set_read_mode(page_size)
 
+        return self._read_pages(range(pages_total))
+
+    def _read_pages(self, page_nos: List[int]) -> bytes:
         output_data = []
-        for page_no in range(pages_total):
-            resp = self.json_rpc_client.send_request("read_page", [page_no])
+        for resp in self._send_requests([("read_page", [page_no]) for page_no in page_nos]):
             output_data += resp
 
         return bytes(output_data)
 
+    def hash_range(self, start_address: int, length: int, algorithm: str = "crc32") -> int:
+        if algorithm not in self.HASH_ALGORITHMS:
+            raise EepromProgrammerClientError(
+                f"unsupported hash algorithm: {algorithm}")
+
+        # hash_range reads through the READ mode
+        self._set_read_mode(self.read_page_size)
+
+        timeout_sec = self.json_rpc_client.RESPONSE_READ_TIMEOUT_SEC + length * self._HASH_BYTE_TIME_SEC
+        try:
+            resp = self.json_rpc_client.send_request(
+                "hash_range", [start_address, length, algorithm], timeout_sec)
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to hash {length} bytes at {start_address} with: {ex}")
+
+        # the board sends the digest as int32
+        return resp[0] & 0xFFFFFFFF
+
+    @staticmethod
+    def hash_data(data: bytes, algorithm: str = "crc32") -> int:
+        if algorithm == "crc32":
+            return zlib.crc32(data)
+        elif algorithm == "crc16":
+            # CCITT-FALSE, the same as the board
+            return binascii.crc_hqx(data, 0xFFFF)
+        elif algorithm == "sum8":
+            return sum(data) & 0xFF
+        elif algorithm == "sum16":
+            return sum(data) & 0xFFFF
+        raise EepromProgrammerClientError(
+            f"unsupported hash algorithm: {algorithm}")
+
+    def verify_sparse(self, image: SparseImage, algorithm: str = "crc32") -> List[int]:
+        """
+        hashes every image range on the board, returns the mismatched page numbers
+        """
+        page_size = self.read_page_size
+        mismatched_pages = []
+        for start, data in image.ranges:
+            if self.hash_range(start, len(data), algorithm) == self.hash_data(data, algorithm):
+                continue
+
+            # page-level diff only for the mismatched range
+            range_image = SparseImage([(start, data)], sparse=True)
+            range_pages = range_image.pages(page_size)
+            self._set_read_mode(page_size)
+            output_data = self._read_pages(range_pages)
+            for i, page_no in enumerate(range_pages):
+                page_data = output_data[i*page_size:(i+1)*page_size]
+                if range_image.overlay(page_no, page_size, page_data) != page_data and page_no not in mismatched_pages:
+                    mismatched_pages.append(page_no)
+
+        return sorted(mismatched_pages)
+
+    def page_crc_table(self, page_size: int) -> List[int]:
+        # page_crc_table reads through the READ mode
+        self._set_read_mode(page_size)
+
+        memory_size = self.chip_settings["memory_size"]
+        timeout_sec = self.json_rpc_client.RESPONSE_READ_TIMEOUT_SEC + memory_size * self._HASH_BYTE_TIME_SEC
+        try:
+            crc_table = self.json_rpc_client.send_request("page_crc_table", [page_size], timeout_sec)
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to read page CRC table with: {ex}")
+
+        if len(crc_table) != memory_size // page_size:
+            raise EepromProgrammerClientError(
+                f"short page CRC table: {len(crc_table)} / {memory_size // page_size} pages")
+        # the board sends the CRC32s as int32
+        return [crc & 0xFFFFFFFF for crc in crc_table]
+
+    def verify_data(self, input_data: bytes, algorithm: str = "crc32") -> List[int]:
+        """
+        returns the mismatched page numbers, empty if the chip matches `input_data`
+        """
+        digest = self.hash_range(0, len(input_data), algorithm)
+        if digest == self.hash_data(input_data, algorithm):
+            return []
+
+        self.log(f"verify: digest mismatch 0x{digest:08X}, reading pages")
+
+        # page-level diff only on mismatch
+        page_size = self.read_page_size
+        output_data = self.read_data()
+        return [page_no for page_no in range((len(input_data) + page_size - 1) // page_size)
+                if input_data[page_no*page_size:(page_no+1)*page_size] != output_data[page_no*page_size:(page_no+1)*page_size]]
+
     def _set_write_mode(self, page_size: int):
+        # fail before an erase touches the first page
+        if self.chip_settings.get("write_completion") == self.WRITE_COMPLETION_READ_ONLY:
+            raise EepromProgrammerClientError(
+                f"{self.chip_type} is read-only")
         try:
             res = self.json_rpc_client.send_request("set_write_mode", [page_size])
-            print(f"set_write_mode: {res}")
+            self.log(f"set_write_mode: {res}")
         except Exception as ex:
             raise EepromProgrammerClientError(
                 f"failed to set WRITE mode with: {ex}")
 
-    def write_data(self, input_data: bytes, collect_write_performance: bool = False):
-        page_size = self._WRITE_PAGE_SIZE
+    def write_data(self, input_data: bytes, collect_write_performance: bool = False, delta: bool = False,
+                   journal: Optional[WriteJournal] = None, start_page: int = 0):
+        page_size = self.write_page_size
         pages_total = int(len(input_data) / page_size)
         # last page
         if len(input_data) > pages_total * page_size:
             pages_total += 1
 
-        # set WRITE mode
-        self._set_write_mode(page_size)
+        pages_to_write = range(start_page, pages_total)
+        if delta:
+            pages_to_write = [page_no for page_no in self._changed_pages(input_data, page_size) if page_no >= start_page]
+            self.log(f"delta write: {len(pages_to_write)} of {pages_total} pages changed")
+
+        pages = []
+        for page_no in pages_to_write:
+            address = page_no * page_size
+            pages.append((page_no, input_data[address:(address+page_size)]))
+
+        self._write_pages(pages, collect_write_performance, journal)
+
+        # the skipped pages only matched by CRC, the whole image is checked once
+        if delta:
+            mismatched_pages = self.verify_data(input_data)
+            if mismatched_pages:
+                raise EepromProgrammerClientError(
+                    f"delta write: verify failed, mismatched pages {mismatched_pages}")
+            self.log("delta write: verified")
+
+    def write_sparse(self, image: SparseImage, collect_write_performance: bool = False):
+        """
+        programs only the pages touched by the image ranges
+        partially covered pages are read first, so the bytes outside the ranges are kept
+        """
+        page_size = self.write_page_size
+        pages_to_write = image.pages(page_size)
+        partial_pages = [page_no for page_no in pages_to_write if not image.covers_page(page_no, page_size)]
+        self.log(f"sparse write: {len(pages_to_write)} pages, {len(partial_pages)} partial")
+
+        current_pages = {}
+        if partial_pages:
+            self._set_read_mode(page_size)
+            current_data = self._read_pages(partial_pages)
+            for i, page_no in enumerate(partial_pages):
+                current_pages[page_no] = current_data[i*page_size:(i+1)*page_size]
 
-        # convert bytes to array
-        input_data = [b for b in input_data]
+        pages = []
+        for page_no in pages_to_write:
+            base = current_pages.get(page_no, bytes(page_size))
+            pages.append((page_no, image.overlay(page_no, page_size, base)))
 
+        self._write_pages(pages, collect_write_performance)
+
+    def _write_pages(self, pages: List[Tuple[int, bytes]], collect_write_performance: bool = False,
+                     journal: Optional[WriteJournal] = None):
+        # set WRITE mode
+        self._set_write_mode(self.write_page_size)
+
+        # the board keeps the write-cycle wait of every byte, one request at the end reads it
         if collect_write_performance:
-            write_performance = []
+            self.reset_stats()
 
-        for page_no in range(pages_total):
-            address = page_no * page_size
-            page_data = input_data[address:(address+page_size)]
-            self.json_rpc_client.send_request("write_page", [page_no, page_data])
-            if collect_write_performance:
-                write_performance.extend(self.json_rpc_client.send_request("get_write_perf", None))
+        requests = []
+        for page_no, page_data in pages:
+            # convert bytes to array
+            requests.append(("write_page", [page_no, [b for b in page_data]]))
+
+        progress_pages = set(len(pages) * step // self.WRITE_PROGRESS_STEPS
+                             for step in range(1, self.WRITE_PROGRESS_STEPS + 1))
+
+        # the board confirms pages in order
+        def on_response(request_no: int, resp: Any):
+            method, params = requests[request_no]
+            if journal is not None and method == "write_page":
+                journal.confirm_page(params[0])
+            pages_done = request_no + 1
+            if pages_done in progress_pages and pages_done < len(pages):
+                self.log(f"write progress: {pages_done} of {len(pages)} pages")
+
+        self._send_requests(requests, on_response, self.WRITE_PIPELINE_DEPTH)
 
         if collect_write_performance:
-            print("AVG write time {:.2f} ms".format(sum(write_performance) / len(write_performance)))
+            self.log(f"write-cycle wait ({self.write_timing()}): {self.get_stats()['write_wait'].summary()}")
+
+    def write_journal(self, image_filename: str, input_data: bytes) -> WriteJournal:
+        return WriteJournal.for_image(image_filename, input_data, self.chip_type, self.write_page_size,
+                                      self.json_rpc_client.port)
+
+    def resume_page(self, journal: WriteJournal, input_data: bytes) -> int:
+        """
+        returns the first page to write, the last confirmed pages are re-checked on the chip
+        """
+        page_size = journal.page_size
+        first_page = max(0, journal.last_page + 1 - self.RESUME_RECHECK_PAGES)
+        recheck_pages = list(range(first_page, journal.last_page + 1))
+        if not recheck_pages:
+            return 0
+
+        self._set_read_mode(page_size)
+        output_data = self._read_pages(recheck_pages)
+        for i, page_no in enumerate(recheck_pages):
+            expected = input_data[page_no*page_size:(page_no+1)*page_size]
+            if output_data[i*page_size:(i*page_size+len(expected))] != expected:
+                self.log(f"resume: page {page_no} does not match the image")
+                return page_no
+
+        return journal.last_page + 1
+
+    def _changed_pages(self, input_data: bytes, page_size: int) -> List[int]:
+        crc_table = self.page_crc_table(page_size)
+        changed_pages = []
+        for page_no in range((len(input_data) + page_size - 1) // page_size):
+            page_data = input_data[page_no*page_size:(page_no+1)*page_size]
+            # a partial last page cannot be compared, always write it
+            if len(page_data) < page_size or crc_table[page_no] != self.hash_data(page_data, "crc32"):
+                changed_pages.append(page_no)
+        return changed_pages
 
     def erase_data(self, erase_pattern: int, collect_write_performance: bool = False):
         if erase_pattern < 0 or erase_pattern > 255:
@@ -95,3 +334,175 @@ class EepromProgrammerClient:
         input_data = bytes([erase_pattern] * memory_size)
 
         self.write_data(input_data, collect_write_performance)
+
+    # order of the `get_stage_times` result
+    STAGE_TIMES = ("requests", "parse_usec", "bus_io_usec", "write_wait_usec", "send_usec")
+
+    def get_stage_times(self) -> Dict[str, int]:
+        try:
+            stage_times = self.json_rpc_client.send_request("get_stage_times", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to get stage times with: {ex}")
+        return dict(zip(self.STAGE_TIMES, stage_times))
+
+    def reset_stage_times(self):
+        try:
+            self.json_rpc_client.send_request("reset_stage_times", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to reset stage times with: {ex}")
+
+    # order of the `get_link_stats` result
+    LINK_STATS = ("bytes_received", "bytes_sent", "frames", "parse_errors", "overflows", "flush_usec")
+
+    def get_link_stats(self) -> Dict[str, int]:
+        """serial link counters of the board since the last reset, received and sent from the board side"""
+        try:
+            link_stats = self.json_rpc_client.send_request("get_link_stats", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to get link stats with: {ex}")
+        return {name: value & 0xFFFFFFFF for name, value in zip(self.LINK_STATS, link_stats)}
+
+    def reset_link_stats(self):
+        try:
+            self.json_rpc_client.send_request("reset_link_stats", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to reset link stats with: {ex}")
+
+    # order of the `get_stats` histograms
+    STATS_HISTOGRAMS = ("write_wait", "bus_read_page", "parse", "send")
+
+    def get_stats(self) -> Dict[str, LatencyHistogram]:
+        try:
+            stats = self.json_rpc_client.send_request("get_stats", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to get stats with: {ex}")
+        histograms, buckets = stats[0], stats[1]
+        size = 4 + buckets
+        if histograms != len(self.STATS_HISTOGRAMS) or len(stats) != 2 + histograms * size:
+            raise EepromProgrammerClientError(
+                f"unexpected stats layout: {histograms} histograms, {buckets} buckets, {len(stats)} values")
+        return {
+            name: LatencyHistogram.from_ints(stats[2 + i * size:2 + (i + 1) * size])
+            for i, name in enumerate(self.STATS_HISTOGRAMS)
+        }
+
+    def reset_stats(self):
+        try:
+            self.json_rpc_client.send_request("reset_stats", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to reset stats with: {ex}")
+
+    # order of the `get_write_status` result, the states of `WriteState` in eeprom_programmer_lib.h
+    WRITE_STATUS = ("state", "start_address", "bytes_done", "bytes_total", "elapsed_usec", "result")
+    WRITE_STATES = {0: "idle", 1: "load", 2: "pulse", 3: "poll", 4: "verify", 5: "next"}
+
+    def get_write_status(self) -> Dict[str, Any]:
+        """the page write in progress on the board, or the last one when idle"""
+        try:
+            status = dict(zip(self.WRITE_STATUS, self.json_rpc_client.send_request("get_write_status", [])))
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to get write status with: {ex}")
+        status["state"] = self.WRITE_STATES.get(status["state"], f"state_{status['state']}")
+        return status
+
+    def cancel_write(self):
+        """the pending `write_page` fails with WRITE_CANCELLED after the byte in its write cycle"""
+        try:
+            self.json_rpc_client.send_request("cancel_write", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to cancel write with: {ex}")
+
+    # order of the `get_memory` result
+    MEMORY_STATS = ("static_bytes", "free_heap_bytes", "largest_free_block_bytes", "stack_peak_bytes",
+                    "stack_headroom_bytes", "request_doc_peak_capacity", "request_doc_peak_usage", "message_peak_bytes")
+
+    def get_memory(self) -> Dict[str, int]:
+        """SRAM use of the board, the stack since boot or the last reset, the request peaks since the last reset"""
+        try:
+            memory = self.json_rpc_client.send_request("get_memory", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to get memory with: {ex}")
+        return dict(zip(self.MEMORY_STATS, memory))
+
+    def reset_memory(self):
+        try:
+            self.json_rpc_client.send_request("reset_memory", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to reset memory with: {ex}")
+
+    # ids of the `dump_trace` events, see stage_trace.h
+    TRACE_EVENTS = {
+        1: "rx_begin", 2: "rx_end", 3: "rx_overflow", 4: "parse_end", 5: "parse_error", 6: "send_begin", 7: "send_end",
+        20: "read_page_begin", 21: "read_page_end", 22: "hash_begin", 23: "hash_end",
+        24: "write_page_begin", 25: "write_page_end", 26: "write_poll_end",
+    }
+
+    def dump_trace(self) -> Tuple[int, int, List[Tuple[str, int, int]]]:
+        """drains the board trace: depth (0 when the firmware has no trace), dropped records, (event, micros, arg)"""
+        try:
+            trace = self.json_rpc_client.send_request("dump_trace", [])
+        except Exception as ex:
+            raise EepromProgrammerClientError(
+                f"failed to dump trace with: {ex}")
+        if len(trace) < 2 or (len(trace) - 2) % 3 != 0:
+            raise EepromProgrammerClientError(f"unexpected trace layout: {len(trace)} values")
+        depth, dropped = trace[0], trace[1] & 0xFFFFFFFF
+        records = [
+            (self.TRACE_EVENTS.get(event, f"event_{event}"), micros & 0xFFFFFFFF, arg)
+            for event, micros, arg in zip(trace[2::3], trace[3::3], trace[4::3])
+        ]
+        return depth, dropped, records
+
+    def _send_requests(self, requests: List[Tuple[str, Optional[List[Any]]]],
+                       on_response: Optional[Callable[[int, Any], None]] = None,
+                       max_pipeline_depth: Optional[int] = None) -> List[Any]:
+        pipeline_depth = self.pipeline_depth
+        if max_pipeline_depth is not None:
+            pipeline_depth = min(pipeline_depth, max_pipeline_depth)
+        if pipeline_depth == 1:
+            responses = []
+            for method, params in requests:
+                responses.append(self.json_rpc_client.send_request(method, params))
+                if on_response is not None:
+                    on_response(len(responses) - 1, responses[-1])
+            return responses
+        return asyncio.run(self._send_requests_pipelined(requests, pipeline_depth, on_response))
+
+    async def _send_requests_pipelined(self, requests: List[Tuple[str, Optional[List[Any]]]], pipeline_depth: int,
+                                       on_response: Optional[Callable[[int, Any], None]] = None) -> List[Any]:
+        responses = []
+
+        async def wait(future, method):
+            responses.append(await async_client.wait(future, method))
+            if on_response is not None:
+                on_response(len(responses) - 1, responses[-1])
+
+        async with AsyncSerialJsonRpcClient(self.json_rpc_client) as async_client:
+            in_flight = []
+            try:
+                for method, params in requests:
+                    # keep at most `pipeline_depth` requests in flight
+                    if len(in_flight) >= pipeline_depth:
+                        await wait(*in_flight.pop(0))
+                    in_flight.append((async_client.submit(method, params), method))
+                while in_flight:
+                    await wait(*in_flight.pop(0))
+            except BaseException:
+                # the first failure is raised, the requests behind it are abandoned
+                for future, _ in in_flight:
+                    if not future.done():
+                        future.cancel()
+                    elif not future.cancelled():
+                        future.exception()
+                raise
+        return responses
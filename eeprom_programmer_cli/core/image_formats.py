@@ -0,0 +1,178 @@
+from typing import Dict, List, Tuple
+
+import os
+
+
+class ImageFormatError(Exception):
+    pass
+
+
+class SparseImage:
+    """
+    memory image as a sorted list of non-overlapping (start_address, data) ranges
+    """
+
+    def __init__(self, ranges: List[Tuple[int, bytes]], sparse: bool):
+        self.ranges = ranges
+        # flat binary images always start at 0 and cover the whole file
+        self.sparse = sparse
+
+    @classmethod
+    def from_bytes(cls, chunks: Dict[int, bytes]) -> "SparseImage":
+        # merge adjacent chunks, reject overlapping ones
+        ranges: List[Tuple[int, bytearray]] = []
+        for address in sorted(chunks):
+            data = chunks[address]
+            if not data:
+                continue
+            if ranges:
+                last_start, last_data = ranges[-1]
+                last_end = last_start + len(last_data)
+                if address < last_end:
+                    raise ImageFormatError(f"overlapping data at 0x{address:08X}")
+                if address == last_end:
+                    last_data.extend(data)
+                    continue
+            ranges.append((address, bytearray(data)))
+        return cls([(start, bytes(data)) for start, data in ranges], sparse=True)
+
+    @property
+    def size(self) -> int:
+        return sum(len(data) for _, data in self.ranges)
+
+    @property
+    def end_address(self) -> int:
+        if not self.ranges:
+            return 0
+        start, data = self.ranges[-1]
+        return start + len(data)
+
+    def flat_data(self) -> bytes:
+        return self.ranges[0][1] if self.ranges else b""
+
+    def pages(self, page_size: int) -> List[int]:
+        """
+        page numbers touched by the ranges, aligned to the chip page boundaries
+        """
+        pages = set()
+        for start, data in self.ranges:
+            pages.update(range(start // page_size, (start + len(data) - 1) // page_size + 1))
+        return sorted(pages)
+
+    def overlay(self, page_no: int, page_size: int, page_data: bytes) -> bytes:
+        """
+        returns `page_data` with the image bytes of this page applied on top
+        """
+        page_start = page_no * page_size
+        page = bytearray(page_data)
+        for start, data in self.ranges:
+            begin = max(start, page_start)
+            end = min(start + len(data), page_start + page_size)
+            if begin < end:
+                page[(begin - page_start):(end - page_start)] = data[(begin - start):(end - start)]
+        return bytes(page)
+
+    def covers_page(self, page_no: int, page_size: int) -> bool:
+        page_start = page_no * page_size
+        return any(start <= page_start and page_start + page_size <= start + len(data) for start, data in self.ranges)
+
+
+_INTEL_HEX_EXTENSIONS = (".hex", ".ihex", ".ihx")
+_SRECORD_EXTENSIONS = (".srec", ".s19", ".s28", ".s37", ".mot")
+
+
+def load_image(filename: str) -> SparseImage:
+    extension = os.path.splitext(filename)[1].lower()
+    if extension in _INTEL_HEX_EXTENSIONS:
+        with open(filename, "r") as f:
+            return parse_intel_hex(f.read())
+    if extension in _SRECORD_EXTENSIONS:
+        with open(filename, "r") as f:
+            return parse_srecord(f.read())
+
+    with open(filename, "rb") as f:
+        data = bytes(f.read())
+    return SparseImage([(0, data)] if data else [], sparse=False)
+
+
+def _record_bytes(record: str, line_no: int) -> bytes:
+    try:
+        return bytes.fromhex(record)
+    except ValueError:
+        raise ImageFormatError(f"line {line_no}: invalid hex digits")
+
+
+def parse_intel_hex(text: str) -> SparseImage:
+    chunks: Dict[int, bytes] = {}
+    base_address = 0
+
+    for line_no, line in enumerate(text.splitlines(), start=1):
+        line = line.strip()
+        if not line:
+            continue
+        if not line.startswith(":"):
+            raise ImageFormatError(f"line {line_no}: record must start with ':'")
+
+        record = _record_bytes(line[1:], line_no)
+        if len(record) < 5 or len(record) != 5 + record[0]:
+            raise ImageFormatError(f"line {line_no}: invalid record length")
+        if sum(record) & 0xFF != 0:
+            raise ImageFormatError(f"line {line_no}: checksum mismatch")
+
+        byte_count, record_type = record[0], record[3]
+        offset = (record[1] << 8) | record[2]
+        data = record[4:(4 + byte_count)]
+
+        if record_type == 0x00:  # data
+            address = base_address + offset
+            if address in chunks:
+                raise ImageFormatError(f"line {line_no}: overlapping data at 0x{address:08X}")
+            chunks[address] = data
+        elif record_type == 0x01:  # end of file
+            break
+        elif record_type in (0x02, 0x04):  # extended segment / linear address
+            if byte_count != 2:
+                raise ImageFormatError(f"line {line_no}: record type {record_type:02X} needs 2 data bytes")
+            base_address = ((data[0] << 8) | data[1]) << (4 if record_type == 0x02 else 16)
+        elif record_type in (0x03, 0x05):  # start address, not used by EEPROMs
+            continue
+        else:
+            raise ImageFormatError(f"line {line_no}: unsupported record type {record_type:02X}")
+
+    return SparseImage.from_bytes(chunks)
+
+
+def parse_srecord(text: str) -> SparseImage:
+    chunks: Dict[int, bytes] = {}
+    # S1/S2/S3 data records use 2/3/4 address bytes
+    address_sizes = {"1": 2, "2": 3, "3": 4}
+
+    for line_no, line in enumerate(text.splitlines(), start=1):
+        line = line.strip()
+        if not line:
+            continue
+        if len(line) < 4 or line[0] != "S":
+            raise ImageFormatError(f"line {line_no}: record must start with 'S'")
+
+        record_type = line[1]
+        record = _record_bytes(line[2:], line_no)
+        if len(record) < 3 or len(record) != 1 + record[0]:
+            raise ImageFormatError(f"line {line_no}: invalid record length")
+        if sum(record) & 0xFF != 0xFF:
+            raise ImageFormatError(f"line {line_no}: checksum mismatch")
+
+        if record_type in address_sizes:
+            address_size = address_sizes[record_type]
+            # count, address and checksum
+            if len(record) < 1 + address_size + 1:
+                raise ImageFormatError(f"line {line_no}: invalid record length")
+            address = int.from_bytes(record[1:(1 + address_size)], "big")
+            if address in chunks:
+                raise ImageFormatError(f"line {line_no}: overlapping data at 0x{address:08X}")
+            chunks[address] = record[(1 + address_size):-1]
+        elif record_type in ("0", "5", "6", "7", "8", "9"):  # header, count, start address
+            continue
+        else:
+            raise ImageFormatError(f"line {line_no}: unsupported record type S{record_type}")
+
+    return SparseImage.from_bytes(chunks)
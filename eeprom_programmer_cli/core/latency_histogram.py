@@ -0,0 +1,57 @@
+from typing import List
+
+
+class LatencyHistogram:
+    """
+    client side of the board `LatencyHistogram`: two log-scaled buckets per octave of usec,
+    [0, 2), [2, 3), [3, 4), [4, 6), [6, 8), [8, 12) ..., the last bucket is open-ended
+    percentiles interpolate linearly inside a bucket, clamped to the exact min and max
+    """
+
+    def __init__(self, count: int, min_usec: int, max_usec: int, sum_usec: int, buckets: List[int]):
+        self.count = count
+        self.min_usec = min_usec
+        self.max_usec = max_usec
+        self.sum_usec = sum_usec
+        self.buckets = buckets
+
+    @classmethod
+    def from_ints(cls, values: List[int]) -> "LatencyHistogram":
+        # the board sends unsigned counters as int32
+        values = [v & 0xFFFFFFFF for v in values]
+        return cls(values[0], values[1], values[2], values[3], values[4:])
+
+    @staticmethod
+    def bucket_lower_bound(bucket: int) -> int:
+        if bucket == 0:
+            return 0
+        msb, half = (bucket + 1) // 2, (bucket + 1) % 2
+        return (1 << msb) + half * (1 << (msb - 1))
+
+    @property
+    def mean_usec(self) -> float:
+        return self.sum_usec / self.count if self.count else 0.0
+
+    def percentile(self, p: float) -> float:
+        if not self.count:
+            return 0.0
+        rank = p / 100.0 * self.count
+        seen = 0
+        for bucket, bucket_count in enumerate(self.buckets):
+            if not bucket_count:
+                continue
+            if seen + bucket_count >= rank:
+                lower = max(self.bucket_lower_bound(bucket), self.min_usec)
+                upper = self.max_usec
+                if bucket + 1 < len(self.buckets):
+                    upper = min(self.bucket_lower_bound(bucket + 1), self.max_usec)
+                return lower + (upper - lower) * (rank - seen) / bucket_count
+            seen += bucket_count
+        return float(self.max_usec)
+
+    def summary(self) -> str:
+        if not self.count:
+            return "no samples"
+        return (f"n {self.count}, min {self.min_usec} us, p50 {self.percentile(50):.0f} us, "
+                f"p90 {self.percentile(90):.0f} us, p99 {self.percentile(99):.0f} us, max {self.max_usec} us, "
+                f"mean {self.mean_usec:.0f} us")
@@ -0,0 +1,67 @@
+import hashlib
+import json
+import os
+
+
+class WriteJournalError(Exception):
+    pass
+
+
+class WriteJournal:
+    """
+    checkpoint of a `write_data` run, kept next to the image file
+    stores the image hash, chip type, page size and the last page confirmed by the board
+    """
+
+    SUFFIX = ".journal"
+
+    def __init__(self, path: str, image_hash: str, chip_type: str, page_size: int):
+        self.path = path
+        self.image_hash = image_hash
+        self.chip_type = chip_type
+        self.page_size = page_size
+        self.last_page = -1
+
+    @classmethod
+    def for_image(cls, image_filename: str, input_data: bytes, chip_type: str, page_size: int, port: str) -> "WriteJournal":
+        # one journal per board, gang mode writes the same image on several ports
+        path = f"{image_filename}.{os.path.basename(port)}{cls.SUFFIX}"
+        return cls(path, hashlib.sha256(input_data).hexdigest(), chip_type.upper(), page_size)
+
+    def exists(self) -> bool:
+        return os.path.exists(self.path)
+
+    def load(self):
+        try:
+            with open(self.path, "r") as f:
+                state = json.load(f)
+        except Exception as ex:
+            raise WriteJournalError(f"failed to read journal {self.path} with {str(ex)}")
+
+        # a journal is only valid for the same image on the same chip
+        for key in ("image_hash", "chip_type", "page_size"):
+            if state.get(key) != getattr(self, key):
+                raise WriteJournalError(
+                    f"journal {self.path} mismatch: {key} is {state.get(key)}, expected {getattr(self, key)}")
+        self.last_page = int(state.get("last_page", -1))
+
+    def confirm_page(self, page_no: int):
+        self.last_page = page_no
+        self.save()
+
+    def save(self):
+        state = {
+            "image_hash": self.image_hash,
+            "chip_type": self.chip_type,
+            "page_size": self.page_size,
+            "last_page": self.last_page,
+        }
+        # write and rename, so a crash never leaves a truncated journal
+        tmp_path = self.path + ".tmp"
+        with open(tmp_path, "w") as f:
+            json.dump(state, f)
+        os.replace(tmp_path, self.path)
+
+    def remove(self):
+        if self.exists():
+            os.remove(self.path)
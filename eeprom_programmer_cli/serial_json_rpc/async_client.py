@@ -0,0 +1,126 @@
+from typing import Any, Dict, List, Optional
+
+import asyncio
+import json
+
+from serial_json_rpc.client import SerialJsonRpcClient, SerialJsonRpcClientError
+
+
+class AsyncSerialJsonRpcClient:
+    """
+    asyncio front-end for an initialized `SerialJsonRpcClient`
+
+    a background reader task matches responses to outstanding requests by `id`,
+    so several requests can be in flight and awaited as futures
+    """
+
+    # the board reports framing errors (parse error, overflow) with id 0
+    _UNMATCHED_REQUEST_ID = SerialJsonRpcClient.UNMATCHED_REQUEST_ID
+
+    def __init__(self, json_rpc_client: SerialJsonRpcClient):
+        self.json_rpc_client = json_rpc_client
+        #
+        self._pending: Dict[int, asyncio.Future] = {}
+        self._reader_task: Optional[asyncio.Task] = None
+        self._running = False
+
+    async def __aenter__(self) -> "AsyncSerialJsonRpcClient":
+        await self.start()
+        return self
+
+    async def __aexit__(self, *exc_info):
+        await self.stop()
+
+    async def start(self):
+        if self.json_rpc_client.serial is None:
+            raise SerialJsonRpcClientError("uninitialized serial protocol")
+        if self._reader_task is not None:
+            # already started
+            return
+        self._running = True
+        self._reader_task = asyncio.get_running_loop().create_task(self._reader_loop())
+
+    async def stop(self):
+        if self._reader_task is None:
+            return
+        self._running = False
+        await self._reader_task
+        self._reader_task = None
+        self._fail_pending(SerialJsonRpcClientError("client stopped"))
+
+    def submit(self, method: str, params: Optional[List[Any]]) -> asyncio.Future:
+        if self._reader_task is None:
+            raise SerialJsonRpcClientError("async client is not started")
+
+        # share the id sequence with the synchronous client
+        request = self.json_rpc_client._build_request(method, params)
+        future = asyncio.get_running_loop().create_future()
+        self._pending[request["id"]] = future
+
+        w_res = self.json_rpc_client.serial.write(self.json_rpc_client._encode_request(request))
+        if not w_res:
+            self._pending.pop(request["id"], None)
+            raise SerialJsonRpcClientError(
+                "failed to send request, 0 bytes written")
+
+        return future
+
+    async def wait(self, future: asyncio.Future, method: str) -> Any:
+        try:
+            return await asyncio.wait_for(future, self.json_rpc_client.RESPONSE_READ_TIMEOUT_SEC)
+        except asyncio.TimeoutError:
+            raise SerialJsonRpcClientError(
+                f"failed to read response for {method}, resp_wait_sec = {self.json_rpc_client.RESPONSE_READ_TIMEOUT_SEC}")
+
+    async def send_request(self, method: str, params: Optional[List[Any]]) -> Any:
+        return await self.wait(self.submit(method, params), method)
+
+    async def _reader_loop(self):
+        loop = asyncio.get_running_loop()
+        while self._running:
+            try:
+                chunk = await loop.run_in_executor(None, self._read_chunk)
+            except Exception as ex:
+                self._fail_pending(SerialJsonRpcClientError(f"failed to read response with {str(ex)}"))
+                return
+            if not chunk:
+                continue
+            self.json_rpc_client._append_received(chunk)
+            self._dispatch_frames()
+
+    def _read_chunk(self) -> bytes:
+        # the port timeout of the synchronous client bounds the read, so `stop()` is noticed
+        serial = self.json_rpc_client.serial
+        return serial.read(max(1, serial.in_waiting))
+
+    def _dispatch_frames(self):
+        end_of_message = self.json_rpc_client._END_OF_JSON_RPC_MESSAGE
+        while end_of_message in self.json_rpc_client._read_buffer:
+            frame, self.json_rpc_client._read_buffer = self.json_rpc_client._read_buffer.split(end_of_message, 1)
+            try:
+                raw_response = self.json_rpc_client._decode_frame(frame)
+            except (UnicodeDecodeError, json.JSONDecodeError):
+                continue
+            # valid JSON but not a response object (debug output), skipped like the synchronous client does
+            if not isinstance(raw_response, dict):
+                self.json_rpc_client.stats.stale_frames += 1
+                continue
+
+            request_id = raw_response.get("id", self._UNMATCHED_REQUEST_ID)
+            future = self._pending.pop(request_id, None)
+            if future is None and request_id == self._UNMATCHED_REQUEST_ID and self._pending:
+                # the board lost track of a request, fail the oldest one
+                future = self._pending.pop(next(iter(self._pending)))
+            if future is None or future.done():
+                continue
+
+            try:
+                future.set_result(self.json_rpc_client._parse_response(raw_response))
+            except SerialJsonRpcClientError as ex:
+                future.set_exception(ex)
+
+    def _fail_pending(self, ex: Exception):
+        for future in self._pending.values():
+            if not future.done():
+                future.set_exception(ex)
+        self._pending.clear()
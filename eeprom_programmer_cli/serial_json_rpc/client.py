@@ -5,11 +5,28 @@ import time
 
 import serial
 
+from serial_json_rpc.request_recorder import RequestRecorder
+
 
 class SerialJsonRpcClientError(Exception):
     pass
 
 
+class TransportStats:
+    """
+    host side of the link: wire bytes and the time spent encoding requests and decoding responses
+    """
+
+    def __init__(self):
+        self.requests = 0
+        self.bytes_sent = 0
+        self.bytes_received = 0
+        self.encode_time_sec = 0.0
+        self.decode_time_sec = 0.0
+        # responses that arrived after their request timed out, dropped by id
+        self.stale_frames = 0
+
+
 class SerialJsonRpcClient:
     """
     https://pyserial.readthedocs.io/en/latest/pyserial.html
@@ -20,15 +37,32 @@ class SerialJsonRpcClient:
 
     RESPONSE_READ_TIMEOUT_SEC = 2.0
 
+    # the serial read blocks at most this long, set once on the port; the reader checks its own
+    # deadline between reads, a timeout change per read costs a tcsetattr() on every chunk
+    READ_POLL_SEC = 0.05
+
+    # the board reports framing errors (parse error, overflow) with id 0, so requests never use it
+    UNMATCHED_REQUEST_ID = 0
+    # the board reads the id into an AVR int, the ids wrap from here back to 1
+    MAX_REQUEST_ID = 0x7FFF
+
+    # the board terminates every JSON RPC message with \n
+    _END_OF_JSON_RPC_MESSAGE = b"\n"
+
     def __init__(self, port: str, baudrate: int, init_timeout: float, read_timeout: Optional[float] = None, write_timeout: Optional[float] = None):
         self.port = port
         self.baudrate = baudrate
         self.init_timeout = init_timeout
-        self.read_timeout = read_timeout
+        # the blocking slice of one serial read, not the response timeout
+        self.read_timeout = read_timeout if read_timeout is not None else self.READ_POLL_SEC
         self.write_timeout = write_timeout
         #
         self.serial = None
-        self.json_rpc_request_id = 0
+        self.json_rpc_request_id = 1
+        self._read_buffer = b""
+        self.stats = TransportStats()
+        # optional per-request timeline, see `RequestRecorder`
+        self.recorder: Optional[RequestRecorder] = None
 
     def init(self) -> str:
         if self.serial is not None:
@@ -51,14 +85,14 @@ class SerialJsonRpcClient:
         # can be None
         return response
 
-    def send_request(self, method: str, params: Optional[List[Any]]) -> str:
+    def send_request(self, method: str, params: Optional[List[Any]], timeout_sec: Optional[float] = None) -> str:
         if self.serial is None:
             raise SerialJsonRpcClientError("uninitialized serial protocol")
 
         request = self._build_request(method, params)
 
         # send request and read the amount of written bytes
-        w_res = self.serial.write((json.dumps(request, separators=(',', ':')) + '\n').encode())
+        w_res = self.serial.write(self._encode_request(request))
         if not w_res:
             raise SerialJsonRpcClientError(
                 "failed to send request, 0 bytes written")
@@ -66,7 +100,10 @@ class SerialJsonRpcClient:
         # flush the data to the board
         self.serial.flush()
 
-        response, resp_wait_sec = self._read_response(self.RESPONSE_READ_TIMEOUT_SEC)
+        # long-running methods (range hash) pass their own timeout
+        if timeout_sec is None:
+            timeout_sec = self.RESPONSE_READ_TIMEOUT_SEC
+        response, resp_wait_sec = self._read_response(timeout_sec, request["id"])
         if response is None:
             raise SerialJsonRpcClientError(
                 f"failed to read response for {method}, resp_wait_sec = {resp_wait_sec}")
@@ -83,34 +120,93 @@ class SerialJsonRpcClient:
             request["params"] = params
         else:
             request["params"] = []
-        self.json_rpc_request_id += 1
+        self.json_rpc_request_id = self.json_rpc_request_id % self.MAX_REQUEST_ID + 1
         return request
 
-    def _read_response(self, read_timeout_sec: float) -> Tuple[Optional[str], float]:
+    def reset_stats(self):
+        self.stats = TransportStats()
+
+    def _encode_request(self, request: Dict[str, Any]) -> bytes:
+        start_ts = time.perf_counter()
+        raw_request = (json.dumps(request, separators=(',', ':')) + '\n').encode()
+        self.stats.encode_time_sec += time.perf_counter() - start_ts
+        self.stats.requests += 1
+        self.stats.bytes_sent += len(raw_request)
+        if self.recorder is not None:
+            self.recorder.on_send(request, raw_request)
+        return raw_request
+
+    def _decode_frame(self, frame: bytes) -> Dict[str, Any]:
+        # raises on non-JSON frames
+        start_ts = time.perf_counter()
+        self.stats.bytes_received += len(frame) + len(self._END_OF_JSON_RPC_MESSAGE)
+        try:
+            response = json.loads(frame.decode())
+        finally:
+            self.stats.decode_time_sec += time.perf_counter() - start_ts
+        if self.recorder is not None and isinstance(response, dict):
+            self.recorder.on_response(response, len(frame) + len(self._END_OF_JSON_RPC_MESSAGE), bool(self._read_buffer))
+        return response
+
+    def _append_received(self, chunk: bytes):
+        # a chunk into an empty buffer is the first byte of the next response
+        if self.recorder is not None and not self._read_buffer:
+            self.recorder.on_chunk()
+        self._read_buffer += chunk
+
+    def _read_response(self, read_timeout_sec: float, request_id: Optional[int] = None) -> Tuple[Optional[str], float]:
         if self.serial is None:
             raise SerialJsonRpcClientError("uninitialized serial protocol")
 
-        start_ts = time.time()
+        start_ts = time.monotonic()
         deadline_ts = start_ts + read_timeout_sec
 
-        buffer = b""
         raw_response = None
         resp_wait_sec = read_timeout_sec
 
-        # keep reading until full JSON is received
-        while time.time() < deadline_ts:
-            if self.serial.in_waiting > 0:
-                buffer += self.serial.read(self.serial.in_waiting)
-                try:
-                    raw_response = json.loads(buffer.decode())
-                    resp_wait_sec = time.time() - start_ts
-                    break
-                except json.JSONDecodeError:
-                    continue
-            time.sleep(0.05)
+        # block on newline-terminated frames, the deadline is the only timeout
+        # every frame is parsed exactly once, non-JSON frames (reset noise, debug output) are skipped
+        while raw_response is None:
+            frame = self._read_frame(deadline_ts)
+            if frame is None:
+                break
+            try:
+                response = self._decode_frame(frame)
+            except (UnicodeDecodeError, json.JSONDecodeError):
+                continue
+            if not self._is_response_to(response, request_id):
+                self.stats.stale_frames += 1
+                continue
+            raw_response = response
+            resp_wait_sec = time.monotonic() - start_ts
 
         return self._parse_response(raw_response), resp_wait_sec
 
+    def _is_response_to(self, response: Any, request_id: Optional[int]) -> bool:
+        # a late answer to a timed-out request stays in the buffer, it must not answer this one
+        if request_id is None:
+            return True
+        if not isinstance(response, dict):
+            return False
+        response_id = response.get("id", self.UNMATCHED_REQUEST_ID)
+        if response_id == request_id:
+            return True
+        # the board could not read the id of the request
+        return response_id == self.UNMATCHED_REQUEST_ID and "error" in response
+
+    def _read_frame(self, deadline_ts: float) -> Optional[bytes]:
+        # a frame may arrive in several chunks, keep the tail for the next frame
+        while self._END_OF_JSON_RPC_MESSAGE not in self._read_buffer:
+            if time.monotonic() >= deadline_ts:
+                return None
+            # blocks for the first byte up to the port timeout, then drains whatever is already received
+            chunk = self.serial.read(max(1, self.serial.in_waiting))
+            if chunk:
+                self._append_received(chunk)
+
+        frame, self._read_buffer = self._read_buffer.split(self._END_OF_JSON_RPC_MESSAGE, 1)
+        return frame.strip()
+
     def _parse_response(self, response: Optional[Dict[str, Any]]) -> Optional[str]:
         if response is None:
             return None
@@ -0,0 +1,195 @@
+from typing import Any, Dict, List, Optional
+
+import json
+import time
+
+
+class RequestRecord:
+    """
+    one request on the wire, host clock in seconds since the recorder start
+    the first byte is the first response chunk read after the previous response, an estimate when pipelined
+    """
+
+    def __init__(self, request_id: int, method: str, params_bytes: int, request_bytes: int, send_ts: float):
+        self.request_id = request_id
+        self.method = method
+        self.params_bytes = params_bytes
+        self.request_bytes = request_bytes
+        self.send_ts = send_ts
+        self.first_byte_ts: Optional[float] = None
+        self.done_ts: Optional[float] = None
+        self.response_bytes = 0
+        self.error = False
+
+    @property
+    def latency_sec(self) -> float:
+        return self.done_ts - self.send_ts
+
+
+class RequestRecorder:
+    """
+    records every request of a `SerialJsonRpcClient`, sync and pipelined
+    exports a Chrome/Perfetto trace (chrome://tracing, ui.perfetto.dev) and per-method latency percentiles
+    """
+
+    # the pid of the trace, one process per recorder
+    _TRACE_PID = 1
+    _OPERATIONS_TID = 1
+    _REQUESTS_TID = 2
+
+    # the id of the board's framing errors, the client never sends it
+    _UNMATCHED_REQUEST_ID = 0
+
+    def __init__(self, name: str = "serial_json_rpc"):
+        self.name = name
+        self.records: List[RequestRecord] = []
+        # (name, start_ts, end_ts)
+        self.operations: List[List[Any]] = []
+        self._start_ts = time.perf_counter()
+        # requests sent and not answered yet, in send order
+        self._in_flight: Dict[int, RequestRecord] = {}
+
+    def now(self) -> float:
+        return time.perf_counter() - self._start_ts
+
+    # hooks of the client
+
+    def on_send(self, request: Dict[str, Any], raw_request: bytes):
+        params_bytes = len(json.dumps(request["params"], separators=(',', ':')))
+        record = RequestRecord(request["id"], request["method"], params_bytes, len(raw_request), self.now())
+        self.records.append(record)
+        self._in_flight[record.request_id] = record
+
+    def on_chunk(self):
+        # the chunk starts the response of the oldest request waiting for one
+        for record in self._in_flight.values():
+            if record.first_byte_ts is None:
+                record.first_byte_ts = self.now()
+            return
+
+    def on_response(self, response: Dict[str, Any], response_bytes: int, more_buffered: bool):
+        # framing errors of the board come with id 0, they complete the oldest request
+        record = self._in_flight.pop(response.get("id", self._UNMATCHED_REQUEST_ID), None)
+        if record is None and self._in_flight:
+            record = self._in_flight.pop(next(iter(self._in_flight)))
+        if record is None:
+            return
+        record.done_ts = self.now()
+        if record.first_byte_ts is None:
+            record.first_byte_ts = record.done_ts
+        record.response_bytes = response_bytes
+        record.error = "error" in response
+        # the rest of the chunk belongs to the next response
+        if more_buffered:
+            self.on_chunk()
+
+    # operation spans of the caller, they may nest
+
+    def begin_operation(self, name: str):
+        self.operations.append([name, self.now(), None])
+
+    def end_operation(self):
+        for operation in reversed(self.operations):
+            if operation[2] is None:
+                operation[2] = self.now()
+                return
+
+    # reports
+
+    def completed(self) -> List[RequestRecord]:
+        return [record for record in self.records if record.done_ts is not None]
+
+    def method_summary(self) -> Dict[str, Dict[str, float]]:
+        """round-trip and first-byte latency percentiles per method, msec"""
+        by_method: Dict[str, List[RequestRecord]] = {}
+        for record in self.completed():
+            by_method.setdefault(record.method, []).append(record)
+
+        summary = {}
+        for method, records in by_method.items():
+            latencies = sorted(record.latency_sec * 1000 for record in records)
+            first_bytes = sorted((record.first_byte_ts - record.send_ts) * 1000 for record in records)
+            summary[method] = {
+                "count": len(records),
+                "errors": sum(1 for record in records if record.error),
+                "p50_ms": self._percentile(latencies, 50),
+                "p90_ms": self._percentile(latencies, 90),
+                "p99_ms": self._percentile(latencies, 99),
+                "max_ms": latencies[-1],
+                "first_byte_p50_ms": self._percentile(first_bytes, 50),
+                "request_bytes": sum(record.request_bytes for record in records) / len(records),
+                "response_bytes": sum(record.response_bytes for record in records) / len(records),
+            }
+        return summary
+
+    def idle_sec(self) -> float:
+        """time without a request in flight between the first send and the last response"""
+        records = self.completed()
+        if not records:
+            return 0.0
+        idle = 0.0
+        busy_until = None
+        for record in sorted(records, key=lambda r: r.send_ts):
+            if busy_until is not None and record.send_ts > busy_until:
+                idle += record.send_ts - busy_until
+            busy_until = record.done_ts if busy_until is None else max(busy_until, record.done_ts)
+        return idle
+
+    def chrome_trace(self) -> Dict[str, Any]:
+        events: List[Dict[str, Any]] = [
+            self._metadata("process_name", 0, {"name": self.name}),
+            self._metadata("thread_name", self._OPERATIONS_TID, {"name": "operations"}),
+            self._metadata("thread_name", self._REQUESTS_TID, {"name": "requests"}),
+        ]
+
+        for name, start_ts, end_ts in self.operations:
+            if end_ts is None:
+                continue
+            events.append({"name": name, "cat": "operation", "ph": "X", "pid": self._TRACE_PID, "tid": self._OPERATIONS_TID,
+                           "ts": self._usec(start_ts), "dur": self._usec(end_ts - start_ts)})
+
+        # pipelined requests overlap, async events keep them on separate rows
+        in_flight = []
+        for record in self.completed():
+            common = {"cat": "rpc", "pid": self._TRACE_PID, "tid": self._REQUESTS_TID, "id": record.request_id}
+            events.append(dict(common, name=record.method, ph="b", ts=self._usec(record.send_ts), args={
+                "id": record.request_id,
+                "params_bytes": record.params_bytes,
+                "request_bytes": record.request_bytes,
+                "response_bytes": record.response_bytes,
+                "error": record.error,
+            }))
+            events.append(dict(common, name="response", ph="b", ts=self._usec(record.first_byte_ts)))
+            events.append(dict(common, name="response", ph="e", ts=self._usec(record.done_ts)))
+            events.append(dict(common, name=record.method, ph="e", ts=self._usec(record.done_ts)))
+            in_flight.append((record.send_ts, 1))
+            in_flight.append((record.done_ts, -1))
+
+        depth = 0
+        for ts, step in sorted(in_flight):
+            depth += step
+            events.append({"name": "in_flight", "ph": "C", "pid": self._TRACE_PID, "ts": self._usec(ts),
+                           "args": {"requests": depth}})
+
+        return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+    def save_chrome_trace(self, filename: str):
+        with open(filename, "w") as f:
+            json.dump(self.chrome_trace(), f, separators=(',', ':'))
+
+    def _metadata(self, name: str, tid: int, args: Dict[str, Any]) -> Dict[str, Any]:
+        return {"name": name, "ph": "M", "pid": self._TRACE_PID, "tid": tid, "args": args}
+
+    @staticmethod
+    def _usec(sec: float) -> float:
+        return round(sec * 1e6, 1)
+
+    @staticmethod
+    def _percentile(sorted_values: List[float], p: float) -> float:
+        # linear interpolation between the closest ranks
+        if len(sorted_values) == 1:
+            return sorted_values[0]
+        rank = p / 100.0 * (len(sorted_values) - 1)
+        lower = int(rank)
+        upper = min(lower + 1, len(sorted_values) - 1)
+        return sorted_values[lower] + (sorted_values[upper] - sorted_values[lower]) * (rank - lower)
@@ -0,0 +1,304 @@
+#!/usr/bin/env python3
+
+from typing import Any, Callable, Dict, List, Optional
+
+import argparse
+import binascii
+import json
+import zlib
+import os
+import threading
+import time
+import tty
+
+
+class FakeBoardError(Exception):
+    pass
+
+
+class FakeChip:
+    """
+    in-memory 28Cxx EEPROM, mirrors the firmware's page addressing
+    """
+
+    CHIP_MEMORY_SIZE = {
+        "AT28C64": 8 * 1024,
+        "AT28C256": 32 * 1024,
+        "AT28C16": 2 * 1024,
+    }
+
+    MAX_PAGE_SIZE = 128
+
+    def __init__(self, chip_type: str, fill: int = 0xFF):
+        chip_type = chip_type.upper()
+        if chip_type not in self.CHIP_MEMORY_SIZE:
+            raise FakeBoardError(f"chip not supported: {chip_type}")
+        self.chip_type = chip_type
+        self.memory = bytearray([fill] * self.CHIP_MEMORY_SIZE[chip_type])
+        self.page_size = 0
+
+    @property
+    def memory_size(self) -> int:
+        return len(self.memory)
+
+    def read_page(self, page_no: int) -> List[int]:
+        start = self._page_start(page_no)
+        return list(self.memory[start:(start+self.page_size)])
+
+    def write_page(self, page_no: int, data: List[int]) -> int:
+        if len(data) > self.page_size:
+            raise FakeBoardError("invalid page size")
+        start = self._page_start(page_no)
+        self.memory[start:(start+len(data))] = bytes(data)
+        return len(data)
+
+    def _page_start(self, page_no: int) -> int:
+        if self.page_size <= 0:
+            raise FakeBoardError("mode is not set")
+        if page_no < 0 or page_no >= self.memory_size // self.page_size:
+            raise FakeBoardError(f"invalid page no: {page_no}")
+        return page_no * self.page_size
+
+
+class FakeBoard:
+    """
+    pty-backed stand-in for the EEPROM Programmer board
+    speaks the same newline-framed JSON RPC as `eeprom_programmer.ino`
+    """
+
+    JSON_RPC_VERSION = "2.0"
+
+    def __init__(self, fill: int = 0xFF, drop_after: Optional[int] = None, drop_count: Optional[int] = None,
+                 split_sec: float = 0.0, response_delays: Optional[Dict[int, float]] = None):
+        self.fill = fill
+        # stop answering after this many requests, simulates a dropped link
+        self.drop_after = drop_after
+        # answer again after this many dropped frames, a link that comes back; None drops for good
+        self.drop_count = drop_count
+        self.dropped_total = 0
+        # every response is written in two halves this far apart, a frame split by the USB transfers
+        self.split_sec = split_sec
+        # request no (1-based) -> seconds its response is held back, a board busy past the client timeout
+        self.response_delays = response_delays or {}
+        self.chip: Optional[FakeChip] = None
+        # the content survives re-connects, like a chip left in the socket
+        self._chips: Dict[str, FakeChip] = {}
+        self.requests_total = 0
+        # `get_link_stats` counters, the fake board never overflows and writes without flushing
+        self.link_stats = [0] * 6
+        #
+        self._master_fd, self._slave_fd = os.openpty()
+        # raw mode, the same as a real USB CDC port
+        tty.setraw(self._slave_fd)
+        self.port = os.ttyname(self._slave_fd)
+        self._thread = None
+        self._methods: Dict[str, Callable[[List[Any]], Any]] = {
+            "init_chip": self._init_chip,
+            "set_read_mode": self._set_read_mode,
+            "read_page": self._read_page,
+            "set_write_mode": self._set_write_mode,
+            "write_page": self._write_page,
+            "hash_range": self._hash_range,
+            "page_crc_table": self._page_crc_table,
+            "get_write_perf": self._get_write_perf,
+            "get_stats": self._get_stats,
+            "reset_stats": self._reset_stats,
+            "dump_trace": self._dump_trace,
+            "get_link_stats": self._get_link_stats,
+            "reset_link_stats": self._reset_link_stats,
+            "get_write_status": self._get_write_status,
+            "cancel_write": self._cancel_write,
+            "get_memory": self._get_memory,
+            "reset_memory": self._reset_memory,
+        }
+
+    def start(self) -> str:
+        self._thread = threading.Thread(target=self.serve, daemon=True)
+        self._thread.start()
+        return self.port
+
+    def serve(self):
+        buffer = b""
+        while True:
+            try:
+                chunk = os.read(self._master_fd, 4096)
+            except OSError:
+                # pty closed
+                return
+            if not chunk:
+                return
+            buffer += chunk
+            self.link_stats[0] += len(chunk)
+            while b"\n" in buffer:
+                frame, buffer = buffer.split(b"\n", 1)
+                if self._is_dropped():
+                    self.dropped_total += 1
+                    continue
+                self.link_stats[2] += 1
+                response = self._process_frame(frame)
+                raw_response = (json.dumps(response, separators=(',', ':')) + "\n").encode()
+                delay_sec = self.response_delays.get(self.requests_total, 0.0)
+                if delay_sec > 0:
+                    time.sleep(delay_sec)
+                self._write_response(raw_response)
+                self.link_stats[1] += len(raw_response)
+
+    def _is_dropped(self) -> bool:
+        if self.drop_after is None or self.requests_total < self.drop_after:
+            return False
+        return self.drop_count is None or self.dropped_total < self.drop_count
+
+    def _write_response(self, raw_response: bytes):
+        if self.split_sec <= 0:
+            os.write(self._master_fd, raw_response)
+            return
+        half = len(raw_response) // 2
+        os.write(self._master_fd, raw_response[:half])
+        time.sleep(self.split_sec)
+        os.write(self._master_fd, raw_response[half:])
+
+    def _process_frame(self, frame: bytes) -> Dict[str, Any]:
+        try:
+            request = json.loads(frame.decode())
+        except (UnicodeDecodeError, json.JSONDecodeError) as ex:
+            self.link_stats[3] += 1
+            return self._error(0, -32700, "Parse error", str(ex))
+
+        self.requests_total += 1
+        request_id = request.get("id", 0)
+        if request.get("jsonrpc") != self.JSON_RPC_VERSION:
+            return self._error(request_id, -32600, "Invalid Request", "Invalid protocol version")
+        params = request.get("params")
+        if not isinstance(params, list):
+            return self._error(request_id, -32602, "Invalid params", "Array expected")
+
+        method = self._methods.get(request.get("method", ""))
+        if method is None:
+            return self._error(request_id, -32601, "Method not found", request.get("method", ""))
+        try:
+            result = method(params)
+        except (FakeBoardError, TypeError, ValueError, IndexError) as ex:
+            return self._error(request_id, -32010, "Service error", str(ex))
+
+        return {"jsonrpc": self.JSON_RPC_VERSION, "id": request_id, "result": result}
+
+    def _error(self, request_id: int, code: int, message: str, data: str) -> Dict[str, Any]:
+        return {"jsonrpc": self.JSON_RPC_VERSION, "id": request_id,
+                "error": {"code": code, "message": message, "data": data}}
+
+    def _init_chip(self, params: List[Any]) -> List[int]:
+        chip_type = str(params[0]).upper()
+        if chip_type not in self._chips:
+            self._chips[chip_type] = FakeChip(chip_type, self.fill)
+        self.chip = self._chips[chip_type]
+        return [self.chip.memory_size, FakeChip.MAX_PAGE_SIZE]
+
+    def _set_page_size(self, params: List[Any]) -> int:
+        if self.chip is None:
+            raise FakeBoardError("chip is not initialized")
+        page_size = int(params[0])
+        if page_size < 1 or page_size > FakeChip.MAX_PAGE_SIZE:
+            raise FakeBoardError("invalid page size")
+        self.chip.page_size = page_size
+        return page_size
+
+    def _set_read_mode(self, params: List[Any]) -> str:
+        return f"READ mode is ON for {self._set_page_size(params)} bytes pages"
+
+    def _read_page(self, params: List[Any]) -> List[int]:
+        return self.chip.read_page(int(params[0]))
+
+    def _set_write_mode(self, params: List[Any]) -> str:
+        return f"WRITE mode is ON for {self._set_page_size(params)} bytes pages"
+
+    def _write_page(self, params: List[Any]) -> str:
+        written = self.chip.write_page(int(params[0]), params[1])
+        return f"WRITE success. {written} bytes written"
+
+    def _hash_range(self, params: List[Any]) -> List[int]:
+        start, length, algorithm = int(params[0]), int(params[1]), str(params[2]).lower()
+        if length < 1 or start < 0 or start + length > self.chip.memory_size:
+            raise FakeBoardError("invalid address")
+        data = bytes(self.chip.memory[start:(start+length)])
+        if algorithm == "crc32":
+            digest = zlib.crc32(data)
+        elif algorithm == "crc16":
+            digest = binascii.crc_hqx(data, 0xFFFF)
+        elif algorithm == "sum8":
+            digest = sum(data) & 0xFF
+        elif algorithm == "sum16":
+            digest = sum(data) & 0xFFFF
+        else:
+            raise FakeBoardError(f"unsupported hash algorithm: {algorithm}")
+        # int32 on the wire, the same as the firmware
+        return [digest - (1 << 32) if digest >= (1 << 31) else digest]
+
+    def _page_crc_table(self, params: List[Any]) -> List[int]:
+        page_size = int(params[0])
+        if page_size < 1 or self.chip.memory_size % page_size != 0:
+            raise FakeBoardError("invalid page size")
+        crc_table = [zlib.crc32(bytes(self.chip.memory[start:(start+page_size)]))
+                     for start in range(0, self.chip.memory_size, page_size)]
+        # int32 on the wire, the same as the firmware
+        return [crc - (1 << 32) if crc >= (1 << 31) else crc for crc in crc_table]
+
+    def _get_write_perf(self, params: List[Any]) -> List[int]:
+        return [0] * self.chip.page_size
+
+    # the fake board has no timing, the histograms of `get_stats` stay empty
+    _STATS_HISTOGRAMS = 4
+    _STATS_BUCKETS = 32
+
+    def _get_stats(self, params: List[Any]) -> List[int]:
+        return [self._STATS_HISTOGRAMS, self._STATS_BUCKETS] + [0] * (self._STATS_HISTOGRAMS * (4 + self._STATS_BUCKETS))
+
+    def _reset_stats(self, params: List[Any]) -> str:
+        return "Stats reset"
+
+    def _get_link_stats(self, params: List[Any]) -> List[int]:
+        return list(self.link_stats)
+
+    def _reset_link_stats(self, params: List[Any]) -> str:
+        self.link_stats = [0] * 6
+        return "Link stats reset"
+
+    # pages are written within the request, the board is always idle between them
+    def _get_write_status(self, params: List[Any]) -> List[int]:
+        return [0, 0, 0, 0, 0, 0]
+
+    def _cancel_write(self, params: List[Any]) -> str:
+        raise FakeBoardError("Failed to cancel WRITE with error: 56")
+
+    # no SRAM (unsupported, -1) and no request documents, like the host build without the peaks
+    def _get_memory(self, params: List[Any]) -> List[int]:
+        return [-1] * 5 + [0] * 3
+
+    def _reset_memory(self, params: List[Any]) -> str:
+        return "Memory peaks reset"
+
+    # a firmware built without the trace
+    def _dump_trace(self, params: List[Any]) -> List[int]:
+        return [0, 0]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Serve a simulated EEPROM Programmer on a pseudo-terminal")
+    parser.add_argument("--fill", type=str, default="FF", metavar="<hex>",
+                        help="Initial chip content, default: FF")
+    parser.add_argument("--drop-after", type=int, default=None, metavar="<n>",
+                        help="Stop answering after <n> requests")
+    parser.add_argument("--drop-count", type=int, default=None, metavar="<n>",
+                        help="Answer again after <n> dropped requests, default: never")
+    args = parser.parse_args()
+
+    board = FakeBoard(fill=int(args.fill, 16), drop_after=args.drop_after, drop_count=args.drop_count)
+    print(f"fake board: {board.port}", flush=True)
+    try:
+        board.serve()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+
+from typing import List, Optional
+
+import argparse
+import errno
+import os
+import select
+import subprocess
+import tempfile
+import threading
+import time
+import tty
+
+
+class FirmwareBoardError(Exception):
+    pass
+
+
+class _LinkThrottle:
+    """
+    limits one direction of the link to the UART rate: 10 bits per byte (8N1)
+    """
+
+    def __init__(self, baudrate: Optional[int]):
+        self.baudrate = baudrate
+        self._free_ts = 0.0
+
+    def wait(self, size: int):
+        if not self.baudrate:
+            return
+        now = time.monotonic()
+        self._free_ts = max(now, self._free_ts) + size * 10.0 / self.baudrate
+        if self._free_ts > now:
+            time.sleep(self._free_ts - now)
+
+
+class FirmwareBoard:
+    """
+    runs the host build of the firmware behind a pseudo-terminal
+    the firmware restarts on every new connection, like an Arduino reset by DTR,
+    the chip content is kept in an image file between sessions
+    """
+
+    DEFAULT_BINARY = "./build/eeprom_programmer_host"
+
+    # read size per relay step, the board UART is byte-oriented
+    _RELAY_CHUNK_SIZE = 64
+    # how often a closed pty is checked for a new connection
+    _RECONNECT_POLL_SEC = 0.005
+
+    def __init__(self, binary: str = DEFAULT_BINARY, chip: str = "AT28C64", baudrate: Optional[int] = None,
+                 image: Optional[str] = None, firmware_args: Optional[List[str]] = None):
+        if not os.path.exists(binary):
+            raise FirmwareBoardError(f"firmware binary not found: {binary}, build it with env/build_host.sh")
+        self.binary = binary
+        self.chip = chip
+        self.baudrate = baudrate
+        self.firmware_args = firmware_args or []
+        self.sessions_total = 0
+        #
+        self._tmp_dir = None
+        if image is None:
+            self._tmp_dir = tempfile.TemporaryDirectory()
+            image = os.path.join(self._tmp_dir.name, "chip.bin")
+        self.image = image
+        #
+        self._master_fd, slave_fd = os.openpty()
+        # raw mode, the same as a real USB CDC port
+        tty.setraw(slave_fd)
+        self.port = os.ttyname(slave_fd)
+        # no slave fd is kept open, so the master sees every disconnect
+        os.close(slave_fd)
+        self._process: Optional[subprocess.Popen] = None
+        self._thread = None
+        self._running = False
+
+    def start(self) -> str:
+        self._running = True
+        self._thread = threading.Thread(target=self.serve, daemon=True)
+        self._thread.start()
+        return self.port
+
+    def stop(self):
+        self._running = False
+        if self._thread is not None:
+            self._thread.join()
+        self._stop_firmware()
+        os.close(self._master_fd)
+
+    def serve(self):
+        to_board = _LinkThrottle(self.baudrate)
+        to_host = _LinkThrottle(self.baudrate)
+        while self._running:
+            # a client connected: reset the board
+            if self._process is None:
+                self._start_firmware()
+
+            fds = [self._master_fd, self._process.stdout]
+            readable, _, _ = select.select(fds, [], [], 0.1)
+
+            if self._master_fd in readable:
+                try:
+                    chunk = os.read(self._master_fd, self._RELAY_CHUNK_SIZE)
+                except OSError as ex:
+                    if ex.errno != errno.EIO:
+                        raise
+                    # the client closed the port
+                    self._wait_for_connection()
+                    continue
+                to_board.wait(len(chunk))
+                self._process.stdin.write(chunk)
+                self._process.stdin.flush()
+
+            if self._process.stdout in readable:
+                chunk = os.read(self._process.stdout.fileno(), self._RELAY_CHUNK_SIZE)
+                if not chunk:
+                    raise FirmwareBoardError("firmware exited")
+                to_host.wait(len(chunk))
+                os.write(self._master_fd, chunk)
+
+    def _start_firmware(self):
+        args = [self.binary, "--chip", self.chip, "--image", self.image] + self.firmware_args
+        self._process = subprocess.Popen(args, stdin=subprocess.PIPE, stdout=subprocess.PIPE, bufsize=0)
+        self.sessions_total += 1
+
+    def _stop_firmware(self):
+        if self._process is None:
+            return
+        # stdin EOF ends the session, the firmware saves the chip image
+        self._process.stdin.close()
+        self._process.wait()
+        self._process = None
+
+    def _wait_for_connection(self):
+        self._stop_firmware()
+        while self._running:
+            readable, _, _ = select.select([self._master_fd], [], [], self._RECONNECT_POLL_SEC)
+            if not readable:
+                continue
+            try:
+                # peek is not available on a pty, the first chunk is replayed to the new session
+                chunk = os.read(self._master_fd, self._RELAY_CHUNK_SIZE)
+            except OSError as ex:
+                if ex.errno != errno.EIO:
+                    raise
+                time.sleep(self._RECONNECT_POLL_SEC)
+                continue
+            self._start_firmware()
+            self._process.stdin.write(chunk)
+            self._process.stdin.flush()
+            return
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Serve the host build of the firmware on a pseudo-terminal")
+    parser.add_argument("--binary", type=str, default=FirmwareBoard.DEFAULT_BINARY, metavar="<path>",
+                        help=f"Host firmware binary, default: {FirmwareBoard.DEFAULT_BINARY}")
+    parser.add_argument("--chip", type=str, default="AT28C64", metavar="<chip>",
+                        help="Chip in the simulated socket, default: AT28C64")
+    parser.add_argument("--baudrate", type=int, default=None, metavar="<baud>",
+                        help="Simulated link speed, default: unlimited")
+    parser.add_argument("--image", type=str, default=None, metavar="<filename>",
+                        help="Chip content kept between sessions")
+    args, firmware_args = parser.parse_known_args()
+
+    board = FirmwareBoard(args.binary, args.chip, args.baudrate, args.image, firmware_args)
+    print(f"firmware board: {board.port}", flush=True)
+    try:
+        board.serve()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+
+from typing import Dict, List
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+from sim.fake_board import FakeBoard
+from sim.firmware_board import FirmwareBoard
+
+CLI_PATH = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "cli.py")
+
+
+class ScenarioError(Exception):
+    pass
+
+
+def load_scenario(filename: str) -> Dict:
+    with open(filename, "r") as f:
+        scenario = json.load(f)
+    for key in ("chip", "steps"):
+        if key not in scenario:
+            raise ScenarioError(f"{filename}: '{key}' is missing")
+    for step in scenario["steps"]:
+        if "name" not in step or "args" not in step:
+            raise ScenarioError(f"{filename}: every step needs 'name' and 'args'")
+    return scenario
+
+
+def start_board(backend: str, scenario: Dict, binary: str, baudrate: int):
+    if backend == "firmware":
+        board = FirmwareBoard(binary, scenario["chip"], baudrate, firmware_args=scenario.get("firmware_args"))
+    else:
+        board = FakeBoard(fill=scenario.get("fill", 0xFF), drop_after=scenario.get("drop_after"),
+                          drop_count=scenario.get("drop_count"))
+    return board, board.start()
+
+
+def start_boards(backend: str, scenario: Dict, binary: str, baudrate: int) -> List[str]:
+    # `boards` runs the gang mode, every entry overrides the scenario settings of its board
+    ports = []
+    for board_settings in scenario.get("boards", [{}]):
+        _, port = start_board(backend, dict(scenario, **board_settings), binary, baudrate)
+        ports.append(port)
+    return ports
+
+
+def run_step(step: Dict, ports: List[str], chip: str, tmp_dir: str) -> Dict:
+    # {port}, {port0}, {port1}.. and {tmp} placeholders let steps pass files between each other
+    placeholders = dict(port=ports[0], tmp=tmp_dir, **{f"port{board_no}": port for board_no, port in enumerate(ports)})
+    args = [arg.format(**placeholders) for arg in step["args"]]
+    # every board by default, `ports` picks some of them
+    step_ports = [port.format(**placeholders) for port in step.get("ports", ports)]
+    command = [sys.executable, CLI_PATH] + step_ports + ["-p", chip, "--init-timeout", "0"] + args
+    env = dict(os.environ, PYTHONPATH=os.path.dirname(CLI_PATH))
+    start_ts = time.monotonic()
+    process = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, env=env)
+    wall_time_sec = time.monotonic() - start_ts
+    expected_rc = step.get("expect_rc", 0)
+    output = process.stdout.decode(errors="replace")
+    # the lines a step must print, e.g. where a resumed write starts
+    expected_output = [text.format(**placeholders) for text in step.get("expect_output", [])]
+    missing_output = [text for text in expected_output if text not in output]
+    return {
+        "name": step["name"],
+        "args": args,
+        "rc": process.returncode,
+        "passed": process.returncode == expected_rc and not missing_output,
+        "missing_output": missing_output,
+        "wall_time_sec": round(wall_time_sec, 3),
+        "output": output,
+    }
+
+
+def run_scenario(filename: str, backend: str, binary: str, baudrate_override: int = None) -> Dict:
+    scenario = load_scenario(filename)
+    # the link drops of the fake board have no firmware counterpart
+    backend = scenario.get("backend", backend)
+    baudrate = baudrate_override if baudrate_override is not None else scenario.get("baudrate")
+    ports = start_boards(backend, scenario, binary, baudrate)
+    results: List[Dict] = []
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        # the steps work on copies, the files written next to them stay in {tmp}
+        for path in scenario.get("files", []):
+            shutil.copy(path, tmp_dir)
+        for step in scenario["steps"]:
+            result = run_step(step, ports, scenario["chip"], tmp_dir)
+            results.append(result)
+            if not result["passed"]:
+                break
+    return {
+        "scenario": os.path.basename(filename),
+        "backend": backend,
+        "chip": scenario["chip"],
+        "baudrate": baudrate,
+        "passed": len(results) == len(scenario["steps"]) and all(r["passed"] for r in results),
+        "steps": results,
+    }
+
+
+def print_report(report: Dict, verbose: bool):
+    baudrate = report["baudrate"] or "unlimited"
+    print(f"{report['scenario']}: {report['chip']}, {report['backend']}, baudrate: {baudrate}")
+    for step in report["steps"]:
+        status = "ok" if step["passed"] else f"FAILED (rc {step['rc']})"
+        for text in step["missing_output"]:
+            status += f", no '{text}'"
+        print(f"  {step['name']:<32} {step['wall_time_sec']:8.3f} sec  {status}")
+        if verbose or not step["passed"]:
+            for line in step["output"].splitlines():
+                print(f"    | {line}")
+    print(f"  {'PASSED' if report['passed'] else 'FAILED'}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run CLI scenarios against a simulated board")
+    parser.add_argument("scenario", type=str, nargs="+", metavar="<scenario.json>",
+                        help="Scenario files")
+    parser.add_argument("--backend", type=str, default="firmware", choices=("firmware", "fake"),
+                        help="firmware: host build of the sketch, fake: Python board, default: firmware")
+    parser.add_argument("--binary", type=str, default=FirmwareBoard.DEFAULT_BINARY, metavar="<path>",
+                        help=f"Host firmware binary, default: {FirmwareBoard.DEFAULT_BINARY}")
+    parser.add_argument("--baudrate", type=int, default=None, metavar="<baud>",
+                        help="Override the simulated link speed of the scenarios, 0: unlimited")
+    parser.add_argument("--json", type=str, default=None, metavar="<filename>",
+                        help="Write the results as JSON")
+    parser.add_argument("-v", "--verbose", action="store_true",
+                        help="Show the CLI output of every step")
+    args = parser.parse_args()
+
+    reports = []
+    for filename in args.scenario:
+        report = run_scenario(filename, args.backend, args.binary, args.baudrate)
+        print_report(report, args.verbose)
+        reports.append(report)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(reports, f, indent=2)
+
+    if not all(r["passed"] for r in reports):
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,52 @@
+import binascii
+import unittest
+
+from core.eeprom_programmer_client import EepromProgrammerClient
+from serial_json_rpc.client import SerialJsonRpcClient
+from sim.fake_board import FakeBoard
+
+
+class DeltaWriteTest(unittest.TestCase):
+    """
+    `write_data(delta=True)` against the pty fake board: the pages it skips must match the image
+    """
+
+    BAUDRATE = 115200
+
+    def _connect(self, board: FakeBoard) -> EepromProgrammerClient:
+        client = SerialJsonRpcClient(board.start(), self.BAUDRATE, init_timeout=0)
+        client.init()
+        self.addCleanup(client.serial.close)
+        programmer = EepromProgrammerClient(client, log=lambda message: None)
+        programmer.init_chip("AT28C64")
+        return programmer
+
+    @staticmethod
+    def _crc16_collision(page: bytes) -> bytes:
+        # another first byte, the last two bytes bring the CRC16 back: CRC is linear, one pair fits
+        crc16 = binascii.crc_hqx(page, 0xFFFF)
+        prefix = bytes([page[0] ^ 0xFF]) + page[1:-2]
+        for tail in range(1 << 16):
+            other = prefix + tail.to_bytes(2, "big")
+            if binascii.crc_hqx(other, 0xFFFF) == crc16:
+                return other
+        raise AssertionError("no CRC16 collision")
+
+    def test_crc16_collision_is_written(self):
+        programmer = self._connect(FakeBoard())
+        page_size = programmer.write_page_size
+        memory_size = programmer.chip_settings["memory_size"]
+
+        chip_data = bytes(range(256)) * (memory_size // 256)
+        programmer.write_data(chip_data)
+
+        page = self._crc16_collision(chip_data[:page_size])
+        self.assertNotEqual(page, chip_data[:page_size])
+        image_data = page + chip_data[page_size:]
+        programmer.write_data(image_data, delta=True)
+
+        self.assertEqual(programmer.verify_data(image_data), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
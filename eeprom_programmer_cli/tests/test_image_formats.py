@@ -0,0 +1,97 @@
+import unittest
+
+from core.image_formats import ImageFormatError, parse_intel_hex, parse_srecord
+
+
+def ihex(record_type: int, offset: int, data: bytes) -> str:
+    record = bytes([len(data), offset >> 8, offset & 0xFF, record_type]) + data
+    return ":" + (record + bytes([-sum(record) & 0xFF])).hex().upper()
+
+
+def srec(record_type: str, address: int, address_size: int, data: bytes) -> str:
+    record = bytes([address_size + len(data) + 1]) + address.to_bytes(address_size, "big") + data
+    return f"S{record_type}" + (record + bytes([~sum(record) & 0xFF])).hex().upper()
+
+
+class IntelHexTest(unittest.TestCase):
+
+    def test_data_and_end_of_file(self):
+        image = parse_intel_hex("\n".join([
+            ihex(0x00, 0x0000, b"\x01\x02"),
+            ihex(0x00, 0x0002, b"\x03"),
+            ihex(0x00, 0x0100, b"\x04"),
+            ihex(0x01, 0x0000, b""),
+            # after the end of file
+            ihex(0x00, 0x0200, b"\x05"),
+        ]))
+        self.assertEqual(image.ranges, [(0x0000, b"\x01\x02\x03"), (0x0100, b"\x04")])
+
+    def test_extended_segment_address(self):
+        image = parse_intel_hex("\n".join([ihex(0x02, 0, b"\x10\x00"), ihex(0x00, 0x0010, b"\xAA")]))
+        self.assertEqual(image.ranges, [(0x10010, b"\xAA")])
+
+    def test_extended_linear_address(self):
+        image = parse_intel_hex("\n".join([ihex(0x04, 0, b"\x00\x01"), ihex(0x00, 0x0010, b"\xAA")]))
+        self.assertEqual(image.ranges, [(0x10010, b"\xAA")])
+
+    def test_extended_address_needs_two_bytes(self):
+        for record_type in (0x02, 0x04):
+            for data in (b"", b"\x01", b"\x00\x01\x02"):
+                with self.assertRaisesRegex(ImageFormatError, "needs 2 data bytes"):
+                    parse_intel_hex(ihex(record_type, 0, data))
+
+    def test_checksum_mismatch(self):
+        record = ihex(0x00, 0, b"\x01\x02")
+        with self.assertRaisesRegex(ImageFormatError, "checksum mismatch"):
+            parse_intel_hex(record[:-2] + "00")
+
+    def test_invalid_record_length(self):
+        with self.assertRaisesRegex(ImageFormatError, "invalid record length"):
+            parse_intel_hex(ihex(0x00, 0, b"\x01\x02")[:-4] + "00")
+
+    def test_overlapping_records(self):
+        with self.assertRaisesRegex(ImageFormatError, "overlapping"):
+            parse_intel_hex("\n".join([ihex(0x00, 0, b"\x01\x02"), ihex(0x00, 0, b"\x03")]))
+        with self.assertRaisesRegex(ImageFormatError, "overlapping"):
+            parse_intel_hex("\n".join([ihex(0x00, 0, b"\x01\x02"), ihex(0x00, 1, b"\x03")]))
+
+    def test_not_a_record(self):
+        with self.assertRaisesRegex(ImageFormatError, "must start with ':'"):
+            parse_intel_hex("0000")
+
+
+class SRecordTest(unittest.TestCase):
+
+    def test_address_sizes(self):
+        for record_type, address_size, address in (("1", 2, 0x1234), ("2", 3, 0x123456), ("3", 4, 0x12345678)):
+            image = parse_srecord("\n".join([
+                srec("0", 0, 2, b"HDR"),
+                srec(record_type, address, address_size, b"\x01\x02"),
+                srec(str(10 - int(record_type)), 0, address_size, b""),
+            ]))
+            self.assertEqual(image.ranges, [(address, b"\x01\x02")])
+
+    def test_adjacent_records_merge(self):
+        image = parse_srecord("\n".join([srec("1", 0x10, 2, b"\x01"), srec("1", 0x11, 2, b"\x02")]))
+        self.assertEqual(image.ranges, [(0x10, b"\x01\x02")])
+
+    def test_checksum_mismatch(self):
+        with self.assertRaisesRegex(ImageFormatError, "checksum mismatch"):
+            parse_srecord(srec("1", 0, 2, b"\x01")[:-2] + "00")
+
+    def test_record_shorter_than_its_address(self):
+        # an S3 record with a 2-byte body
+        with self.assertRaisesRegex(ImageFormatError, "invalid record length"):
+            parse_srecord(srec("3", 0, 2, b""))
+
+    def test_overlapping_records(self):
+        with self.assertRaisesRegex(ImageFormatError, "overlapping"):
+            parse_srecord("\n".join([srec("2", 0x100, 3, b"\x01\x02"), srec("2", 0x101, 3, b"\x03")]))
+
+    def test_unsupported_record_type(self):
+        with self.assertRaisesRegex(ImageFormatError, "unsupported record type S4"):
+            parse_srecord(srec("4", 0, 2, b"\x01"))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,83 @@
+import asyncio
+import time
+import unittest
+
+from serial_json_rpc.async_client import AsyncSerialJsonRpcClient
+from serial_json_rpc.client import SerialJsonRpcClient, SerialJsonRpcClientError
+from sim.fake_board import FakeBoard, FakeChip
+
+
+class SerialJsonRpcClientTest(unittest.TestCase):
+    """
+    the client against the pty fake board: split frames, timeouts and late (stale) responses
+    """
+
+    BAUDRATE = 115200
+
+    def _connect(self, board: FakeBoard, response_timeout_sec: float = 2.0) -> SerialJsonRpcClient:
+        client = SerialJsonRpcClient(board.start(), self.BAUDRATE, init_timeout=0)
+        client.RESPONSE_READ_TIMEOUT_SEC = response_timeout_sec
+        client.init()
+        self.addCleanup(client.serial.close)
+        return client
+
+    def test_split_frame(self):
+        client = self._connect(FakeBoard(split_sec=0.1))
+        self.assertEqual(client.send_request("init_chip", ["AT28C64"]), [8192, FakeChip.MAX_PAGE_SIZE])
+        self.assertEqual(client.send_request("set_read_mode", [16]), "READ mode is ON for 16 bytes pages")
+
+    def test_timeout(self):
+        client = self._connect(FakeBoard(response_delays={1: 0.5}), response_timeout_sec=0.2)
+        start_ts = time.monotonic()
+        with self.assertRaises(SerialJsonRpcClientError):
+            client.send_request("init_chip", ["AT28C64"])
+        # the deadline holds although the port timeout is set only once
+        self.assertLess(time.monotonic() - start_ts, 0.2 + 2 * client.read_timeout)
+
+    def test_stale_frame_is_dropped(self):
+        client = self._connect(FakeBoard(response_delays={1: 0.5}), response_timeout_sec=0.2)
+        with self.assertRaises(SerialJsonRpcClientError):
+            client.send_request("init_chip", ["AT28C64"])
+        # the late `init_chip` response arrives first and must not answer `set_read_mode`
+        client.RESPONSE_READ_TIMEOUT_SEC = 2.0
+        self.assertEqual(client.send_request("set_read_mode", [16]), "READ mode is ON for 16 bytes pages")
+        self.assertEqual(client.stats.stale_frames, 1)
+
+    def test_framing_error_answers_the_request(self):
+        client = self._connect(FakeBoard())
+        client.send_request("init_chip", ["AT28C64"])
+        # the board answers a frame it cannot parse with id 0, the error belongs to the pending request
+        client.serial.write(b"{not json\n")
+        with self.assertRaisesRegex(SerialJsonRpcClientError, "-32700"):
+            client.send_request("set_read_mode", [16])
+
+    def test_late_error_is_not_a_framing_error(self):
+        client = self._connect(FakeBoard(response_delays={1: 0.5}), response_timeout_sec=0.2)
+        # an error response to the first request, late: it must not look like a framing error (id 0)
+        with self.assertRaises(SerialJsonRpcClientError):
+            client.send_request("set_read_mode", [16])
+        client.RESPONSE_READ_TIMEOUT_SEC = 2.0
+        self.assertEqual(client.send_request("init_chip", ["AT28C64"]), [8192, FakeChip.MAX_PAGE_SIZE])
+        self.assertEqual(client.stats.stale_frames, 1)
+
+    def test_request_ids_skip_the_framing_error_id(self):
+        client = self._connect(FakeBoard())
+        client.json_rpc_request_id = client.MAX_REQUEST_ID
+        request_ids = [client._build_request("get_link_stats")["id"] for _ in range(2)]
+        self.assertEqual(request_ids, [client.MAX_REQUEST_ID, 1])
+
+    def test_async_skips_a_non_object_frame(self):
+        client = self._connect(FakeBoard())
+
+        async def init_chip():
+            async with AsyncSerialJsonRpcClient(client) as async_client:
+                # valid JSON that is not a response, it must not stop the reader task
+                client._append_received(b"[1,2]\n")
+                return await async_client.send_request("init_chip", ["AT28C64"])
+
+        self.assertEqual(asyncio.run(init_chip()), [8192, FakeChip.MAX_PAGE_SIZE])
+        self.assertEqual(client.stats.stale_frames, 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
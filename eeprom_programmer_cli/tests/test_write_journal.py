@@ -0,0 +1,56 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+import cli
+from core.eeprom_programmer_client import EepromProgrammerClient
+from serial_json_rpc.client import SerialJsonRpcClient
+from sim.fake_board import FakeBoard
+
+TEST_BIN_DIR = os.path.join(os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))), "test_bin")
+
+
+class WriteJournalTest(unittest.TestCase):
+    """
+    the journal of `cli.write` against the pty fake board: what `--resume` finds after a failed run
+    """
+
+    BAUDRATE = 115200
+
+    def setUp(self):
+        tmp_dir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmp_dir.cleanup)
+        # the journal is written next to the image
+        self.image_path = shutil.copy(os.path.join(TEST_BIN_DIR, "4_echo_orbit_AT28C64_ff.bin"), tmp_dir.name)
+        with open(self.image_path, "rb") as f:
+            self.image_data = f.read()
+
+    def _connect(self, board: FakeBoard) -> EepromProgrammerClient:
+        client = SerialJsonRpcClient(board.start(), self.BAUDRATE, init_timeout=0)
+        client.RESPONSE_READ_TIMEOUT_SEC = 0.2
+        client.init()
+        self.addCleanup(client.serial.close)
+        programmer = EepromProgrammerClient(client, log=lambda message: None)
+        programmer.init_chip("AT28C64")
+        return programmer
+
+    def test_failed_erase_resets_a_stale_journal(self):
+        # the link drops in the erase of the fresh write
+        programmer = self._connect(FakeBoard(drop_after=10))
+        # an earlier run failed high on the chip
+        stale_journal = programmer.write_journal(self.image_path, self.image_data)
+        stale_journal.last_page = 40
+        stale_journal.save()
+
+        with self.assertRaisesRegex(cli.CliError, "erase operation: failed"):
+            cli.write(programmer, self.image_path, None, False, False, False, False)
+
+        # `--resume` must start from the first page, the erase may have blanked any of them
+        journal = programmer.write_journal(self.image_path, self.image_data)
+        journal.load()
+        self.assertEqual(journal.last_page, -1)
+
+
+if __name__ == '__main__':
+    unittest.main()
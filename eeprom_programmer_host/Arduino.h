@@ -0,0 +1,765 @@
+// Arduino core shim for the host build of the EEPROM Programmer firmware
+// covers the API used by `eeprom_programmer/`, pins and time are simulated
+
+#ifndef __arduino_h__
+#define __arduino_h__
+
+#ifndef ARDUINO
+#define ARDUINO 10819
+#endif
+
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+
+// Arduino Mega 2560 clock, the avr-gcc flags define it on the board
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+
+// ========================================
+// avr/pgmspace.h: one address space on the host
+// ========================================
+
+#include <strings.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+
+// ========================================
+// Simulated board: pins and virtual time
+// ========================================
+
+// Arduino Mega 2560
+static const uint8_t HOST_NUM_DIGITAL_PINS = 70;
+// the outputs of the 74HC595 address registers, virtual pins after the digital ones
+// register r output Qi is HOST_SHIFT_OUTPUT_PIN_BASE + 8 * r + i
+static const uint8_t HOST_NUM_SHIFT_REGISTERS = 2;
+static const uint8_t HOST_SHIFT_OUTPUT_PIN_BASE = HOST_NUM_DIGITAL_PINS;
+static const uint8_t HOST_NUM_PINS = HOST_SHIFT_OUTPUT_PIN_BASE + 8 * HOST_NUM_SHIFT_REGISTERS;
+
+// the external interrupts of the Mega, INTn of digitalPinToInterrupt is on HOST_INTERRUPT_PINS[n]
+// the pin-change interrupts are not simulated, digitalPinToPCICR is 0 for every pin
+static const uint8_t HOST_INTERRUPT_PINS[] = { 2, 3, 21, 20, 19, 18 };
+static const uint8_t HOST_NUM_INTERRUPTS = sizeof(HOST_INTERRUPT_PINS) / sizeof(HOST_INTERRUPT_PINS[0]);
+#define NOT_AN_INTERRUPT -1
+
+// an external device wired to the board pins (the simulated EEPROM chip)
+class HostDevice {
+public:
+  virtual ~HostDevice() {}
+  // a board pin changed its mode or output level
+  virtual void on_pin_change(const uint8_t pin) = 0;
+  // the device drives `pin`, `level` is the driven value
+  virtual bool drives_pin(const uint8_t pin, int& level) = 0;
+  // virtual time moved forward
+  virtual void on_time(const uint64_t now_nsec) = 0;
+};
+
+// the cost of the core calls in virtual time, defaults are for a 16 MHz AVR
+struct HostTiming {
+  uint32_t pin_mode_nsec = 4000;
+  uint32_t digital_write_nsec = 3500;
+  uint32_t digital_read_nsec = 3300;
+  uint32_t micros_nsec = 1000;
+  // SPI.transfer() on top of the 8 bit times: SPDR write, SPIF polling, SPDR read
+  uint32_t spi_transfer_overhead_nsec = 500;
+};
+
+// the number of core calls, per pin for the pin calls
+struct HostCallCounters {
+  uint32_t pin_mode[HOST_NUM_DIGITAL_PINS] = {};
+  uint32_t digital_write[HOST_NUM_DIGITAL_PINS] = {};
+  uint32_t digital_read[HOST_NUM_DIGITAL_PINS] = {};
+  uint32_t delay = 0;
+  uint64_t delay_nsec = 0;
+  uint32_t micros = 0;
+  uint32_t spi_transfer = 0;
+  uint32_t interrupts = 0;
+};
+
+class HostBoard {
+public:
+  HostTiming timing;
+  HostCallCounters counters;
+  // keep the virtual clock behind the wall clock, a session then takes as long as on a real board
+  bool realtime = false;
+
+  void attach(HostDevice* device) {
+    _device = device;
+  }
+
+  // 74HC595 registers sharing SER and SRCLK on the SPI pins, each latched by its own RCLK pin
+  void set_shift_latch_pin(const uint8_t shift_register, const uint8_t latch_pin) {
+    if (shift_register >= HOST_NUM_SHIFT_REGISTERS) {
+      return;
+    }
+    _shift_latch_pins[shift_register] = latch_pin;
+    for (uint8_t i = 0; i < 8; i++) {
+      _pin_mode[HOST_SHIFT_OUTPUT_PIN_BASE + 8 * shift_register + i] = OUTPUT;
+    }
+  }
+
+  // the callback runs from `advance` when the level of the pin changes as `mode` asks,
+  // sampled after every step of the virtual time
+  void attach_interrupt(const uint8_t interrupt_no, void (*callback)(), const int mode) {
+    if (interrupt_no >= HOST_NUM_INTERRUPTS) {
+      return;
+    }
+    _interrupts[interrupt_no].callback = callback;
+    _interrupts[interrupt_no].mode = mode;
+    _interrupts[interrupt_no].level = _level(HOST_INTERRUPT_PINS[interrupt_no]);
+  }
+  void detach_interrupt(const uint8_t interrupt_no) {
+    if (interrupt_no < HOST_NUM_INTERRUPTS) {
+      _interrupts[interrupt_no].callback = 0;
+    }
+  }
+
+  void set_spi_clock(const uint32_t clock_hz) {
+    _spi_clock_hz = clock_hz;
+  }
+
+  // MSB first: after 8 clocks bit i of the byte sits in stage Qi of every register on the chain
+  uint8_t spi_transfer(const uint8_t data) {
+    counters.spi_transfer++;
+    _shift_stage = data;
+    advance(8ULL * 1000000000ULL / _spi_clock_hz + timing.spi_transfer_overhead_nsec);
+    // MISO is not wired
+    return 0;
+  }
+
+  uint8_t pin_mode(const uint8_t pin) const {
+    return _pin_mode[pin];
+  }
+  // output latch, also the pull-up state for INPUT pins like on AVR
+  uint8_t pin_output(const uint8_t pin) const {
+    return _pin_output[pin];
+  }
+
+  void set_pin_mode(const uint8_t pin, const uint8_t mode) {
+    if (pin >= HOST_NUM_DIGITAL_PINS) {
+      return;
+    }
+    counters.pin_mode[pin]++;
+    _pin_mode[pin] = mode;
+    if (mode == INPUT_PULLUP) {
+      _pin_output[pin] = HIGH;
+    } else if (mode == INPUT) {
+      _pin_output[pin] = LOW;
+    }
+    advance(timing.pin_mode_nsec);
+    if (_device) {
+      _device->on_pin_change(pin);
+    }
+  }
+
+  void write_pin(const uint8_t pin, const uint8_t level) {
+    if (pin >= HOST_NUM_DIGITAL_PINS) {
+      return;
+    }
+    counters.digital_write[pin]++;
+    const uint8_t previous_level = _pin_output[pin];
+    _pin_output[pin] = level ? HIGH : LOW;
+    advance(timing.digital_write_nsec);
+    if (_device) {
+      _device->on_pin_change(pin);
+    }
+    if (previous_level == LOW && _pin_output[pin] == HIGH) {
+      _latch_shift_registers(pin);
+    }
+  }
+
+  int read_pin(const uint8_t pin) {
+    if (pin >= HOST_NUM_DIGITAL_PINS) {
+      return LOW;
+    }
+    counters.digital_read[pin]++;
+    advance(timing.digital_read_nsec);
+    return _level(pin);
+  }
+
+  uint64_t now_nsec() const {
+    return _now_nsec;
+  }
+
+  void advance(const uint64_t nsec) {
+    _now_nsec += nsec;
+    if (_device) {
+      _device->on_time(_now_nsec);
+    }
+    _check_interrupts();
+    if (realtime) {
+      _pace();
+    }
+  }
+
+private:
+  // the virtual clock may run ahead of the wall clock by this much before the board sleeps
+  static const uint64_t _PACE_SLACK_NSEC = 1000000;
+
+
+  struct _Interrupt {
+    void (*callback)() = 0;
+    int mode = 0;
+    int level = LOW;
+  };
+
+  HostDevice* _device = 0;
+  uint64_t _now_nsec = 0;
+  _Interrupt _interrupts[HOST_NUM_INTERRUPTS];
+  // the callbacks take time too, their own edges wait for the return
+  bool _in_interrupt = false;
+  uint8_t _pin_mode[HOST_NUM_PINS] = {};
+  uint8_t _pin_output[HOST_NUM_PINS] = {};
+  // shift registers, 0 is not wired
+  uint8_t _shift_latch_pins[HOST_NUM_SHIFT_REGISTERS] = {};
+  uint8_t _shift_stage = 0;
+  uint32_t _spi_clock_hz = 4000000;
+  // virtual and wall time of the last resync
+  uint64_t _pace_virtual_nsec = 0;
+  uint64_t _pace_wall_nsec = 0;
+
+  int _level(const uint8_t pin) {
+    int level = LOW;
+    if (_pin_mode[pin] != OUTPUT && _device && _device->drives_pin(pin, level)) {
+      return level;
+    }
+    // pull-up or the output latch
+    return _pin_output[pin];
+  }
+
+  void _check_interrupts() {
+    if (_in_interrupt) {
+      return;
+    }
+    for (uint8_t i = 0; i < HOST_NUM_INTERRUPTS; i++) {
+      _Interrupt& interrupt = _interrupts[i];
+      if (!interrupt.callback) {
+        continue;
+      }
+      const int level = _level(HOST_INTERRUPT_PINS[i]);
+      const bool fire = level != interrupt.level
+                        && (interrupt.mode == CHANGE || (interrupt.mode == RISING) == (level == HIGH));
+      interrupt.level = level;
+      if (fire) {
+        counters.interrupts++;
+        _in_interrupt = true;
+        interrupt.callback();
+        _in_interrupt = false;
+      }
+    }
+  }
+
+  // RCLK rising edge: the shift stage moves to the outputs
+  void _latch_shift_registers(const uint8_t latch_pin) {
+    for (uint8_t r = 0; r < HOST_NUM_SHIFT_REGISTERS; r++) {
+      if (_shift_latch_pins[r] == 0 || _shift_latch_pins[r] != latch_pin) {
+        continue;
+      }
+      for (uint8_t i = 0; i < 8; i++) {
+        const uint8_t pin = HOST_SHIFT_OUTPUT_PIN_BASE + 8 * r + i;
+        const uint8_t level = (_shift_stage >> i) & 1;
+        if (_pin_output[pin] == level) {
+          continue;
+        }
+        _pin_output[pin] = level;
+        if (_device) {
+          _device->on_pin_change(pin);
+        }
+      }
+    }
+  }
+
+  static uint64_t _wall_nsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  void _pace() {
+    const uint64_t wall_nsec = _wall_nsec();
+    const uint64_t virtual_elapsed_nsec = _now_nsec - _pace_virtual_nsec;
+    const uint64_t wall_elapsed_nsec = wall_nsec - _pace_wall_nsec;
+    if (virtual_elapsed_nsec > wall_elapsed_nsec + _PACE_SLACK_NSEC) {
+      const uint64_t ahead_nsec = virtual_elapsed_nsec - wall_elapsed_nsec;
+      struct timespec ts = { (time_t)(ahead_nsec / 1000000000ULL), (long)(ahead_nsec % 1000000000ULL) };
+      nanosleep(&ts, NULL);
+    } else if (wall_elapsed_nsec > virtual_elapsed_nsec + _PACE_SLACK_NSEC) {
+      // the board was idle (waiting for input), idle time is not a credit
+      _pace_virtual_nsec = _now_nsec;
+      _pace_wall_nsec = wall_nsec;
+    }
+  }
+};
+
+inline HostBoard& host_board() {
+  static HostBoard board;
+  return board;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  host_board().set_pin_mode(pin, mode);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t val) {
+  host_board().write_pin(pin, val);
+}
+
+inline int digitalRead(uint8_t pin) {
+  return host_board().read_pin(pin);
+}
+
+inline int digitalPinToInterrupt(uint8_t pin) {
+  for (uint8_t i = 0; i < HOST_NUM_INTERRUPTS; i++) {
+    if (HOST_INTERRUPT_PINS[i] == pin) {
+      return i;
+    }
+  }
+  return NOT_AN_INTERRUPT;
+}
+
+inline void attachInterrupt(uint8_t interrupt_no, void (*callback)(), int mode) {
+  host_board().attach_interrupt(interrupt_no, callback, mode);
+}
+
+inline void detachInterrupt(uint8_t interrupt_no) {
+  host_board().detach_interrupt(interrupt_no);
+}
+
+// the callbacks run between the core calls, never inside one
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+inline unsigned long micros() {
+  host_board().counters.micros++;
+  host_board().advance(host_board().timing.micros_nsec);
+  return (unsigned long)(host_board().now_nsec() / 1000);
+}
+
+inline unsigned long millis() {
+  return (unsigned long)(host_board().now_nsec() / 1000000);
+}
+
+inline void _host_delay(const uint64_t nsec) {
+  host_board().counters.delay++;
+  host_board().counters.delay_nsec += nsec;
+  host_board().advance(nsec);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  _host_delay((uint64_t)us * 1000);
+}
+
+inline void delay(unsigned long ms) {
+  _host_delay((uint64_t)ms * 1000000);
+}
+
+// util/delay_basic.h: 3 cycles per loop, 0 runs 256 loops
+inline void _delay_loop_1(uint8_t count) {
+  _host_delay((count == 0 ? 256 : count) * 3 * 1000000000ULL / F_CPU);
+}
+
+
+// ========================================
+// String
+// ========================================
+
+class String {
+public:
+  String(const char* cstr = "")
+    : _str(cstr ? cstr : "") {}
+  String(const std::string& str)
+    : _str(str) {}
+  explicit String(char c)
+    : _str(1, c) {}
+  explicit String(int value, unsigned char base = DEC)
+    : _str(_format((long)value, base)) {}
+  explicit String(unsigned int value, unsigned char base = DEC)
+    : _str(_format((unsigned long)value, base)) {}
+  explicit String(long value, unsigned char base = DEC)
+    : _str(_format(value, base)) {}
+  explicit String(unsigned long value, unsigned char base = DEC)
+    : _str(_format(value, base)) {}
+
+  const char* c_str() const {
+    return _str.c_str();
+  }
+  unsigned int length() const {
+    return _str.length();
+  }
+  unsigned char reserve(unsigned int size) {
+    _str.reserve(size);
+    return 1;
+  }
+
+  unsigned char concat(const String& str) {
+    _str += str._str;
+    return 1;
+  }
+  unsigned char concat(const char* cstr) {
+    if (cstr) {
+      _str += cstr;
+    }
+    return 1;
+  }
+  unsigned char concat(const char* cstr, unsigned int length) {
+    _str.append(cstr, length);
+    return 1;
+  }
+  unsigned char concat(char c) {
+    _str += c;
+    return 1;
+  }
+  unsigned char concat(int value) {
+    _str += _format((long)value, DEC);
+    return 1;
+  }
+  unsigned char concat(long value) {
+    _str += _format(value, DEC);
+    return 1;
+  }
+  unsigned char concat(unsigned long value) {
+    _str += _format(value, DEC);
+    return 1;
+  }
+
+  template<typename T>
+  String& operator+=(const T& value) {
+    concat(value);
+    return *this;
+  }
+
+  bool equals(const String& str) const {
+    return _str == str._str;
+  }
+  bool equals(const char* cstr) const {
+    return _str == (cstr ? cstr : "");
+  }
+  bool operator==(const String& str) const {
+    return equals(str);
+  }
+  bool operator==(const char* cstr) const {
+    return equals(cstr);
+  }
+  bool operator!=(const String& str) const {
+    return !equals(str);
+  }
+  bool operator!=(const char* cstr) const {
+    return !equals(cstr);
+  }
+
+  char operator[](unsigned int index) const {
+    return index < _str.length() ? _str[index] : 0;
+  }
+  char charAt(unsigned int index) const {
+    return (*this)[index];
+  }
+
+  void toUpperCase() {
+    for (char& c : _str) {
+      c = toupper(c);
+    }
+  }
+  void toLowerCase() {
+    for (char& c : _str) {
+      c = tolower(c);
+    }
+  }
+
+  long toInt() const {
+    return atol(_str.c_str());
+  }
+
+private:
+  std::string _str;
+
+  static std::string _format(long value, unsigned char base) {
+    if (value < 0 && base == DEC) {
+      return "-" + _format((unsigned long)(-value), base);
+    }
+    return _format((unsigned long)value, base);
+  }
+  static std::string _format(unsigned long value, unsigned char base) {
+    char buf[8 * sizeof(unsigned long) + 1];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%lu", value);
+    return buf;
+  }
+};
+
+
+// ========================================
+// Print / Stream / Serial
+// ========================================
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char* str) {
+    return str ? write((const uint8_t*)str, strlen(str)) : 0;
+  }
+  size_t write(const char* buffer, size_t size) {
+    return write((const uint8_t*)buffer, size);
+  }
+  size_t write(char c) {
+    return write((uint8_t)c);
+  }
+  virtual void flush() {}
+
+  size_t print(const char* str) {
+    return write(str);
+  }
+  size_t print(const String& str) {
+    return write(str.c_str());
+  }
+  size_t print(char c) {
+    return write(c);
+  }
+  size_t print(int value, int base = DEC) {
+    return print((long)value, base);
+  }
+  size_t print(unsigned int value, int base = DEC) {
+    return print((unsigned long)value, base);
+  }
+  size_t print(long value, int base = DEC) {
+    return print(String(value, base));
+  }
+  size_t print(unsigned long value, int base = DEC) {
+    return print(String(value, base));
+  }
+
+  template<typename T>
+  size_t println(const T& value) {
+    return print(value) + println();
+  }
+  size_t println() {
+    return write("\r\n");
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout_ms) {
+    _timeout_ms = timeout_ms;
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+      int c = timedRead();
+      if (c < 0) {
+        break;
+      }
+      *buffer++ = (char)c;
+      count++;
+    }
+    return count;
+  }
+
+protected:
+  unsigned long _timeout_ms = 1000;
+
+  int timedRead() {
+    const unsigned long start_ms = millis();
+    do {
+      int c = read();
+      if (c >= 0) {
+        return c;
+      }
+    } while (millis() - start_ms < _timeout_ms);
+    return -1;
+  }
+};
+
+// USB serial backed by file descriptors, stdin/stdout by default
+class HostSerial : public Stream {
+public:
+  void set_fds(const int in_fd, const int out_fd) {
+    _in_fd = in_fd;
+    _out_fd = out_fd;
+  }
+
+  // in-memory input for the fuzz and bench harnesses, replaces the input descriptor
+  // the buffer must outlive the reads, a null buffer switches back to the descriptor
+  void set_input(const uint8_t* data, const size_t size) {
+    _input_data = data;
+    _input_size = size;
+    _input_pos = 0;
+  }
+  // a negative output descriptor discards the output
+  void discard_output() {
+    _out_fd = -1;
+  }
+  size_t bytes_written() const {
+    return _tx_bytes;
+  }
+
+  void begin(unsigned long baudrate) {
+    _baudrate = baudrate;
+  }
+  void end() {}
+
+  // blocks the host loop until input arrives or `timeout_ms` passes, -1 waits forever
+  // returns false when the input is closed
+  bool wait_input(const int timeout_ms) {
+    if (_rx_pos < _rx_size) {
+      return true;
+    }
+    struct pollfd pfd = { _in_fd, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+      return true;
+    }
+    return _fill() >= 0;
+  }
+
+  int available() override {
+    if (_input_data) {
+      return _input_size - _input_pos;
+    }
+    // a byte takes 10 bit times on the line, the descriptor is checked once per byte time of
+    // the virtual clock: a loop spinning on a write cycle does not poll on every turn
+    if (_rx_pos >= _rx_size && host_board().now_nsec() - _poll_nsec >= _byte_time_nsec()) {
+      _poll_nsec = host_board().now_nsec();
+      struct pollfd pfd = { _in_fd, POLLIN, 0 };
+      if (poll(&pfd, 1, 0) > 0) {
+        _fill();
+      }
+    }
+    return _rx_size - _rx_pos;
+  }
+
+  int read() override {
+    if (!available()) {
+      return -1;
+    }
+    if (_input_data) {
+      return _input_data[_input_pos++];
+    }
+    return _rx_buffer[_rx_pos++];
+  }
+
+  int peek() override {
+    if (!available()) {
+      return -1;
+    }
+    if (_input_data) {
+      return _input_data[_input_pos];
+    }
+    return _rx_buffer[_rx_pos];
+  }
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    _tx_bytes += size;
+    if (_out_fd < 0) {
+      return size;
+    }
+    size_t written = 0;
+    while (written < size) {
+      const ssize_t n = ::write(_out_fd, buffer + written, size - written);
+      if (n <= 0) {
+        break;
+      }
+      written += n;
+    }
+    return written;
+  }
+  using Print::write;
+
+  void flush() override {}
+
+  operator bool() const {
+    return true;
+  }
+
+private:
+  int _in_fd = STDIN_FILENO;
+  int _out_fd = STDOUT_FILENO;
+  unsigned long _baudrate = 0;
+
+  // the AVR core keeps a 64 bytes RX ring, the host reads in bigger chunks
+  uint8_t _rx_buffer[256];
+  int _rx_pos = 0;
+  int _rx_size = 0;
+
+  const uint8_t* _input_data = 0;
+  size_t _input_size = 0;
+  size_t _input_pos = 0;
+  size_t _tx_bytes = 0;
+  uint64_t _poll_nsec = 0;
+
+  uint64_t _byte_time_nsec() const {
+    return _baudrate > 0 ? 10ULL * 1000000000ULL / _baudrate : 0;
+  }
+
+  int _fill() {
+    const ssize_t n = ::read(_in_fd, _rx_buffer, sizeof(_rx_buffer));
+    if (n <= 0) {
+      return -1;
+    }
+    _rx_pos = 0;
+    _rx_size = n;
+    return n;
+  }
+};
+
+inline HostSerial Serial;
+
+#endif  // !__arduino_h__
@@ -0,0 +1,48 @@
+// Host shim of the Arduino SPI library, the part the firmware uses
+// the bytes go to the shift registers of HostBoard, the transfer time follows the SPI clock
+
+#ifndef __spi_h__
+#define __spi_h__
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+  SPISettings()
+    : clock_hz(4000000), bit_order(MSBFIRST), data_mode(SPI_MODE0) {}
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+    : clock_hz(clock), bit_order(bitOrder), data_mode(dataMode) {}
+
+  uint32_t clock_hz;
+  uint8_t bit_order;
+  uint8_t data_mode;
+};
+
+class SPIClass {
+public:
+  void begin() {}
+  void end() {}
+
+  void beginTransaction(const SPISettings& settings) {
+    // the AVR divides the 16 MHz clock by 2 to 128, the fastest rate not above the requested one
+    uint32_t clock_hz = 8000000;
+    while (clock_hz > settings.clock_hz && clock_hz > 125000) {
+      clock_hz /= 2;
+    }
+    host_board().set_spi_clock(clock_hz);
+  }
+  void endTransaction() {}
+
+  uint8_t transfer(uint8_t data) {
+    return host_board().spi_transfer(data);
+  }
+};
+
+inline SPIClass SPI;
+
+#endif  // !__spi_h__
@@ -0,0 +1,87 @@
+// Host build of the EEPROM Programmer firmware
+// runs the sketch against a simulated 28Cxx chip, the serial port is stdin/stdout
+// the process lifetime is one board session: the pty harness restarts it on every connect
+
+#include "Arduino.h"
+#include "sim_28cxx.h"
+
+#include <ArduinoJson.h>
+
+// the Arduino IDE generates prototypes for the sketch functions, after the includes of the sketch
+void rpc_processor(int request_id, const char* method, JsonArray params);
+
+#include "../eeprom_programmer/eeprom_programmer.ino"
+
+using namespace EepromProgrammerHost;
+
+static void usage(const char* name) {
+  fprintf(stderr,
+          "usage: %s [--chip AT28C64|AT28C256|AT28C16|2716] [--write-cycle-usec <usec>] [--byte-load-window-usec <usec>]\n"
+          "          [--fill <hex>] [--image <filename>] [--realtime]\n"
+          "  --image loads the chip content if the file exists and saves it on exit\n"
+          "  --realtime paces the virtual time to the wall clock\n",
+          name);
+}
+
+int main(int argc, char** argv) {
+  const char* chip_type = "AT28C64";
+  const char* image_filename = 0;
+  Sim28CxxConfig config;
+
+  for (int i = 1; i < argc; i++) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--chip") == 0 && has_value) {
+      chip_type = argv[++i];
+    } else if (strcmp(argv[i], "--write-cycle-usec") == 0 && has_value) {
+      config.write_cycle_usec = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--byte-load-window-usec") == 0 && has_value) {
+      config.byte_load_window_usec = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--fill") == 0 && has_value) {
+      config.fill = strtoul(argv[++i], NULL, 16);
+    } else if (strcmp(argv[i], "--image") == 0 && has_value) {
+      image_filename = argv[++i];
+    } else if (strcmp(argv[i], "--realtime") == 0) {
+      host_board().realtime = true;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // the chip in the socket of the build wiring, the client still selects the chip type with `init_chip`
+  Sim28Cxx chip(WiringType::EEPROM_PROGRAMMER_WIRING, str_to_chip_type(chip_type), config);
+  if (!chip.is_valid()) {
+    fprintf(stderr, "chip not supported: %s\n", chip_type);
+    return 1;
+  }
+
+  if (image_filename) {
+    FILE* f = fopen(image_filename, "rb");
+    if (f) {
+      fread(chip.memory().data(), 1, chip.memory().size(), f);
+      fclose(f);
+    }
+  }
+
+  host_board().attach(&chip);
+
+  setup();
+  // a page write in progress keeps the loop running, the input is checked between its steps
+  while (eeprom_programmer.is_write_busy() || Serial.wait_input(-1)) {
+    loop();
+  }
+
+  // the chip stays in the socket, finish the pending write cycle and keep the content
+  if (image_filename) {
+    host_board().advance((uint64_t)config.byte_load_window_usec * 1000 + (uint64_t)config.write_cycle_usec * 1000);
+    FILE* f = fopen(image_filename, "wb");
+    if (!f) {
+      fprintf(stderr, "failed to save %s\n", image_filename);
+      return 1;
+    }
+    fwrite(chip.memory().data(), 1, chip.memory().size(), f);
+    fclose(f);
+  }
+
+  return 0;
+}
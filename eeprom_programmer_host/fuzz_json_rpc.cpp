@@ -0,0 +1,170 @@
+// libFuzzer target for the serial JSON RPC request path of the firmware
+// the input is the byte stream received by the board: line buffering, deserialization,
+// param conversion and dispatch to the sketch, the simulated chip sits behind the dispatch
+//
+// the board keeps its state between inputs like a real session (chip, read/write mode),
+// every input ends with the message terminator, so a partial line does not leak into the next one
+//
+// clang: -fsanitize=fuzzer,address
+// other compilers: -DFUZZ_STANDALONE replays files and random mutations of them
+
+#include "Arduino.h"
+#include "sim_28cxx.h"
+
+#include <ArduinoJson.h>
+
+// the Arduino IDE generates prototypes for the sketch functions, after the includes of the sketch
+void rpc_processor(int request_id, const char* method, JsonArray params);
+
+#include "../eeprom_programmer/eeprom_programmer.ino"
+
+#include <vector>
+
+using namespace EepromProgrammerHost;
+
+static Sim28Cxx* fuzz_chip = 0;
+
+static void fuzz_init() {
+  if (fuzz_chip) {
+    return;
+  }
+  Sim28CxxConfig config;
+  fuzz_chip = new Sim28Cxx(WiringType::DIP28, ChipType::AT28C256, config);
+  host_board().attach(fuzz_chip);
+  Serial.discard_output();
+  setup();
+}
+
+static void fuzz_feed(const uint8_t* data, const size_t size) {
+  Serial.set_input(data, size);
+  while (Serial.available()) {
+    loop();
+  }
+  // a started page write ends within the input, the held one too
+  while (write_request_pending) {
+    loop();
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  fuzz_init();
+  static const uint8_t end_of_message = '\n';
+  fuzz_feed(data, size);
+  fuzz_feed(&end_of_message, 1);
+  Serial.set_input(0, 0);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+static bool read_file(const char* filename, std::vector<uint8_t>& data) {
+  FILE* f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  data.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+static void collect_inputs(const char* path, std::vector<std::vector<uint8_t>>& inputs) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    fprintf(stderr, "not found: %s\n", path);
+    return;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    std::vector<uint8_t> data;
+    if (read_file(path, data)) {
+      inputs.push_back(data);
+    }
+    return;
+  }
+  DIR* dir = opendir(path);
+  if (!dir) {
+    return;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    std::string child = std::string(path) + "/" + entry->d_name;
+    collect_inputs(child.c_str(), inputs);
+  }
+  closedir(dir);
+}
+
+// byte flips, inserts, erases and splices, the structure-unaware half of what libFuzzer does
+static void mutate(std::vector<uint8_t>& data, const std::vector<std::vector<uint8_t>>& inputs) {
+  const int mutations = 1 + rand() % 4;
+  for (int i = 0; i < mutations; i++) {
+    const size_t pos = data.empty() ? 0 : rand() % data.size();
+    switch (rand() % 5) {
+      case 0:
+        if (!data.empty()) {
+          data[pos] ^= 1 << (rand() % 8);
+        }
+        break;
+      case 1:
+        data.insert(data.begin() + pos, (uint8_t)(rand() % 256));
+        break;
+      case 2:
+        if (!data.empty()) {
+          data.erase(data.begin() + pos, data.begin() + pos + 1 + rand() % (data.size() - pos));
+        }
+        break;
+      case 3: {
+        // JSON punctuation hits the parser states more often than random bytes
+        static const char tokens[] = "{}[]\",:0-9e.\\\n ";
+        data.insert(data.begin() + pos, (uint8_t)tokens[rand() % (sizeof(tokens) - 1)]);
+        break;
+      }
+      default: {
+        const std::vector<uint8_t>& other = inputs[rand() % inputs.size()];
+        if (!other.empty()) {
+          const size_t from = rand() % other.size();
+          data.insert(data.begin() + pos, other.begin() + from, other.end());
+        }
+        break;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned long runs = 0;
+  std::vector<std::vector<uint8_t>> inputs;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-runs=", 6) == 0) {
+      runs = strtoul(argv[i] + 6, NULL, 10);
+    } else {
+      collect_inputs(argv[i], inputs);
+    }
+  }
+  if (inputs.empty()) {
+    fprintf(stderr, "usage: %s [-runs=<n>] <corpus dir or file>...\n", argv[0]);
+    return 1;
+  }
+
+  for (const std::vector<uint8_t>& input : inputs) {
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  srand(1);
+  for (unsigned long run = 0; run < runs; run++) {
+    std::vector<uint8_t> data = inputs[rand() % inputs.size()];
+    mutate(data, inputs);
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+  }
+  fprintf(stderr, "done: %zu inputs, %lu mutated runs\n", inputs.size(), runs);
+  return 0;
+}
+
+#endif  // FUZZ_STANDALONE
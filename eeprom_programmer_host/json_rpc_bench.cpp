@@ -0,0 +1,180 @@
+// Throughput of the serial JSON RPC request path of the firmware
+// line buffering, deserialization, param conversion and dispatch, per message size
+// the requests call an unknown method, so the dispatch ends in the error reply without bus work
+// requests/s is host CPU time, compare runs on the same machine; the peak heap is the
+// allocator high-water mark during one request, the same allocations happen on the board
+
+#include "Arduino.h"
+
+#include <ArduinoJson.h>
+
+// the Arduino IDE generates prototypes for the sketch functions, after the includes of the sketch
+void rpc_processor(int request_id, const char* method, JsonArray params);
+
+#include "../eeprom_programmer/eeprom_programmer.ino"
+
+#include <malloc.h>
+
+#include <chrono>
+#include <vector>
+
+
+// ========================================
+// Heap accounting
+// ========================================
+
+// glibc entry points, the wrappers below count every allocation of the process
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+static size_t heap_in_use = 0;
+static size_t heap_peak = 0;
+
+static void heap_add(void* ptr) {
+  if (ptr) {
+    heap_in_use += malloc_usable_size(ptr);
+    if (heap_in_use > heap_peak) {
+      heap_peak = heap_in_use;
+    }
+  }
+}
+
+static void heap_remove(void* ptr) {
+  if (ptr) {
+    heap_in_use -= malloc_usable_size(ptr);
+  }
+}
+
+extern "C" void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+  heap_add(ptr);
+  return ptr;
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  void* ptr = __libc_calloc(count, size);
+  heap_add(ptr);
+  return ptr;
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  heap_remove(ptr);
+  void* new_ptr = __libc_realloc(ptr, size);
+  heap_add(new_ptr ? new_ptr : ptr);
+  return new_ptr;
+}
+
+extern "C" void free(void* ptr) {
+  heap_remove(ptr);
+  __libc_free(ptr);
+}
+
+
+// ========================================
+// Benchmark
+// ========================================
+
+struct BenchResult {
+  size_t message_bytes;
+  unsigned long requests;
+  double requests_per_sec;
+  double usec_per_request;
+  size_t peak_heap_bytes;
+  size_t response_bytes;
+};
+
+// a request of about `message_bytes` with an int array param, the shape of `write_page`
+static std::string build_request(const size_t message_bytes) {
+  std::string request = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"bench_nop\",\"params\":[0,[";
+  const std::string tail = "]]}\n";
+  for (int i = 0; request.size() + tail.size() < message_bytes; i++) {
+    if (i > 0) {
+      request += ",";
+    }
+    request += std::to_string(i % 256);
+  }
+  return request + tail;
+}
+
+static void feed(const std::string& request) {
+  Serial.set_input((const uint8_t*)request.data(), request.size());
+  while (Serial.available()) {
+    loop();
+  }
+}
+
+static BenchResult run(const size_t message_bytes, const unsigned long requests) {
+  const std::string request = build_request(message_bytes);
+
+  // warm up and measure the heap on a single request
+  feed(request);
+  const size_t heap_before = heap_in_use;
+  heap_peak = heap_in_use;
+  const size_t written_before = Serial.bytes_written();
+  feed(request);
+  const size_t peak_heap_bytes = heap_peak - heap_before;
+  const size_t response_bytes = Serial.bytes_written() - written_before;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < requests; i++) {
+    feed(request);
+  }
+  const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  BenchResult result;
+  result.message_bytes = request.size();
+  result.requests = requests;
+  result.requests_per_sec = requests / elapsed_sec;
+  result.usec_per_request = elapsed_sec * 1e6 / requests;
+  result.peak_heap_bytes = peak_heap_bytes;
+  result.response_bytes = response_bytes;
+  return result;
+}
+
+static void usage(const char* name) {
+  fprintf(stderr,
+          "usage: %s [--requests <n>] [--size <bytes>]...\n"
+          "  default sizes: 64 to 768 bytes, the board buffers 600 bytes, longer messages take the overflow path\n",
+          name);
+}
+
+int main(int argc, char** argv) {
+  unsigned long requests = 20000;
+  std::vector<size_t> sizes;
+
+  for (int i = 1; i < argc; i++) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--requests") == 0 && has_value) {
+      requests = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--size") == 0 && has_value) {
+      sizes.push_back(strtoul(argv[++i], NULL, 10));
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (sizes.empty()) {
+    sizes = { 64, 128, 256, 350, 512, 600, 768 };
+  }
+  if (requests < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Serial.discard_output();
+  setup();
+
+  printf("[\n");
+  for (size_t i = 0; i < sizes.size(); i++) {
+    const BenchResult result = run(sizes[i], requests);
+    printf("  {\"message_bytes\": %zu, \"requests\": %lu, \"requests_per_sec\": %.0f, \"usec_per_request\": %.2f, "
+           "\"peak_heap_bytes\": %zu, \"response_bytes\": %zu}%s\n",
+           result.message_bytes, result.requests, result.requests_per_sec, result.usec_per_request,
+           result.peak_heap_bytes, result.response_bytes, i + 1 == sizes.size() ? "" : ",");
+  }
+  printf("]\n");
+
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Request document capacity check of the serial JSON RPC board
+// the longest `write_page` the client sends, a full 128 bytes page of 3-digit values, goes through
+// the receive buffer and a document sized by `_request_capacity()`: the page must be written and
+// read back, a parse error (-32700, NoMemory) means the capacity bound is too tight
+// run it against the ArduinoJson release the board is built with
+
+#include "Arduino.h"
+#include "sim_28cxx.h"
+
+#include <ArduinoJson.h>
+
+// the Arduino IDE generates prototypes for the sketch functions, after the includes of the sketch
+void rpc_processor(int request_id, const char* method, JsonArray params);
+
+#include "../eeprom_programmer/eeprom_programmer.ino"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+using namespace EepromProgrammerHost;
+
+static const int PAGE_SIZE = 128;
+// `_JSON_RPC_BUFFER_SIZE` of the board, the frame must fit without the newline
+static const size_t RECEIVE_BUFFER_SIZE = 600;
+
+static int output_fds[2];
+
+// one request through the sketch, returns its response line
+static std::string call(const std::string& request) {
+  Serial.set_input((const uint8_t*)request.data(), request.size());
+  while (Serial.available() || write_request_pending) {
+    loop();
+  }
+  Serial.set_input(NULL, 0);
+
+  std::string response;
+  char c;
+  while (read(output_fds[0], &c, 1) == 1) {
+    response += c;
+  }
+  return response;
+}
+
+static bool expect(const std::string& response, const char* text) {
+  if (response.find(text) == std::string::npos) {
+    fprintf(stderr, "FAILED: expected `%s` in %s", text, response.c_str());
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  Sim28CxxConfig config;
+  Sim28Cxx chip(WiringType::EEPROM_PROGRAMMER_WIRING, ChipType::AT28C256, config);
+  host_board().attach(&chip);
+
+  if (pipe(output_fds) != 0 || fcntl(output_fds[0], F_SETFL, O_NONBLOCK) != 0) {
+    perror("pipe");
+    return 1;
+  }
+  Serial.set_fds(-1, output_fds[1]);
+  setup();
+
+  std::string page = "[";
+  for (int i = 0; i < PAGE_SIZE; i++) {
+    page += (i > 0 ? "," : "") + std::to_string(255 - i % 2);
+  }
+  page += "]";
+
+  const std::string write_request =
+    "{\"jsonrpc\":\"2.0\",\"id\":32767,\"method\":\"write_page\",\"params\":[255," + page + "]}\n";
+  if (write_request.size() - 1 > RECEIVE_BUFFER_SIZE) {
+    fprintf(stderr, "FAILED: %zu bytes request, the receive buffer holds %zu\n", write_request.size(), RECEIVE_BUFFER_SIZE);
+    return 1;
+  }
+
+  bool passed = true;
+  passed &= expect(call("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"init_chip\",\"params\":[\"AT28C256\"]}\n"), "\"result\"");
+  passed &= expect(call("{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"set_write_mode\",\"params\":[128]}\n"), "\"result\"");
+  passed &= expect(call(write_request), "WRITE success. 128 bytes written");
+  passed &= expect(call("{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"set_read_mode\",\"params\":[128]}\n"), "\"result\"");
+  passed &= expect(call("{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"read_page\",\"params\":[255]}\n"), page.c_str());
+
+  printf("%s: %zu bytes write_page request\n", passed ? "PASSED" : "FAILED", write_request.size());
+  return passed ? 0 : 1;
+}
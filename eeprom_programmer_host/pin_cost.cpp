@@ -0,0 +1,291 @@
+// Pin-operation cost report for the EepromProgrammer bus engine
+// runs the read and write engines against the simulated chip and counts the core calls
+// per operation, split by bus (address, data, control), the report is JSON on stdout
+// on the shift wirings the latch pins count as the address bus, the register bytes as spi_transfer
+
+#include "Arduino.h"
+#include "sim_28cxx.h"
+#include "../eeprom_programmer/eeprom_programmer_lib.h"
+
+#include <vector>
+
+using namespace EepromProgrammerHost;
+using namespace EepromProgrammerLibrary;
+
+enum Bus : int {
+  ADDRESS = 0,
+  DATA = 1,
+  CONTROL = 2,
+  OTHER = 3,
+  BUS_COUNT = 4
+};
+
+static const char* BUS_NAMES[BUS_COUNT] = { "address", "data", "control", "other" };
+
+struct BusCost {
+  uint64_t pin_mode = 0;
+  uint64_t digital_write = 0;
+  uint64_t digital_read = 0;
+};
+
+struct OpCost {
+  const char* op;
+  uint32_t calls = 0;
+  BusCost bus[BUS_COUNT];
+  uint64_t delay = 0;
+  uint64_t delay_nsec = 0;
+  uint64_t micros = 0;
+  uint64_t spi_transfer = 0;
+  uint64_t interrupts = 0;
+  uint64_t virtual_nsec = 0;
+  uint32_t errors = 0;
+};
+
+class PinCostMeter {
+public:
+  PinCostMeter(const WiringType wiring_type, const ChipType chip_type) {
+    for (size_t pin = 0; pin < HOST_NUM_DIGITAL_PINS; pin++) {
+      _bus_of_pin[pin] = Bus::OTHER;
+    }
+    WiringController wiring_controller(wiring_type);
+    wiring_controller.set_chip_type(chip_type);
+    PIN_NO pins[WiringController::MAX_BOARD_BUS_SIZE];
+    size_t size = wiring_controller.get_address_bus_pins(pins, WiringController::MAX_ADDRESS_BUS_SIZE);
+    _assign(pins, size, Bus::ADDRESS);
+    size = wiring_controller.get_data_bus_pins(pins, WiringController::MAX_DATA_BUS_SIZE);
+    _assign(pins, size, Bus::DATA);
+    size = wiring_controller.get_management_pins(pins, WiringController::MAX_MANAGEMENT_SIZE);
+    _assign(pins, size, Bus::CONTROL);
+    PIN_NO latch_pins[2];
+    wiring_controller.get_shift_latch_pins(latch_pins[0], latch_pins[1]);
+    _assign(latch_pins, 2, Bus::ADDRESS);
+  }
+
+  void begin() {
+    _counters = host_board().counters;
+    _now_nsec = host_board().now_nsec();
+  }
+
+  void end(OpCost& cost, const ErrorCode code) {
+    const HostCallCounters& counters = host_board().counters;
+    for (size_t pin = 0; pin < HOST_NUM_DIGITAL_PINS; pin++) {
+      BusCost& bus = cost.bus[_bus_of_pin[pin]];
+      bus.pin_mode += counters.pin_mode[pin] - _counters.pin_mode[pin];
+      bus.digital_write += counters.digital_write[pin] - _counters.digital_write[pin];
+      bus.digital_read += counters.digital_read[pin] - _counters.digital_read[pin];
+    }
+    cost.delay += counters.delay - _counters.delay;
+    cost.delay_nsec += counters.delay_nsec - _counters.delay_nsec;
+    cost.micros += counters.micros - _counters.micros;
+    cost.spi_transfer += counters.spi_transfer - _counters.spi_transfer;
+    cost.interrupts += counters.interrupts - _counters.interrupts;
+    cost.virtual_nsec += host_board().now_nsec() - _now_nsec;
+    cost.calls++;
+    if (code != ErrorCode::SUCCESS) {
+      cost.errors++;
+    }
+  }
+
+private:
+  Bus _bus_of_pin[HOST_NUM_DIGITAL_PINS];
+  HostCallCounters _counters;
+  uint64_t _now_nsec = 0;
+
+  void _assign(const PIN_NO* pins, const size_t size, const Bus bus) {
+    for (size_t i = 0; i < size; i++) {
+      if (pins[i] > 0 && pins[i] < HOST_NUM_DIGITAL_PINS) {
+        _bus_of_pin[pins[i]] = bus;
+      }
+    }
+  }
+};
+
+static void print_per_call(const uint64_t total, const uint32_t calls, const char* name, const bool last = false) {
+  printf("\"%s\": %.2f%s", name, calls ? (double)total / calls : 0.0, last ? "" : ", ");
+}
+
+static void print_op(const OpCost& cost, const bool last) {
+  printf("        {\"op\": \"%s\", \"calls\": %u, \"errors\": %u, \"per_call\": {\n", cost.op, cost.calls, cost.errors);
+  for (int bus = 0; bus < BUS_COUNT; bus++) {
+    printf("          \"%s\": {", BUS_NAMES[bus]);
+    print_per_call(cost.bus[bus].pin_mode, cost.calls, "pin_mode");
+    print_per_call(cost.bus[bus].digital_write, cost.calls, "digital_write");
+    print_per_call(cost.bus[bus].digital_read, cost.calls, "digital_read", true);
+    printf("},\n");
+  }
+  printf("          ");
+  print_per_call(cost.delay, cost.calls, "delay");
+  print_per_call(cost.delay_nsec / 1000, cost.calls, "delay_usec");
+  print_per_call(cost.micros, cost.calls, "micros");
+  print_per_call(cost.spi_transfer, cost.calls, "spi_transfer");
+  print_per_call(cost.interrupts, cost.calls, "interrupts");
+  print_per_call(cost.virtual_nsec / 1000, cost.calls, "virtual_usec", true);
+  printf("\n        }}%s\n", last ? "" : ",");
+}
+
+static bool measure_chip(const WiringType wiring_type, const char* chip_name, const uint32_t page_size, const uint32_t samples,
+                         const bool last) {
+  const ChipType chip_type = str_to_chip_type(chip_name);
+  Sim28CxxConfig config;
+  config.page_size = page_size;
+  Sim28Cxx chip(wiring_type, chip_type, config);
+  if (!chip.is_valid()) {
+    fprintf(stderr, "chip not supported: %s\n", chip_name);
+    return false;
+  }
+  host_board().attach(&chip);
+
+  EepromProgrammer programmer(wiring_type);
+  if (programmer.init_programmer() != ErrorCode::SUCCESS || programmer.init_chip(chip_name) != ErrorCode::SUCCESS) {
+    fprintf(stderr, "failed to init %s\n", chip_name);
+    host_board().attach(0);
+    return false;
+  }
+  if (page_size > programmer.get_max_page_size()) {
+    fprintf(stderr, "invalid page size: %u\n", page_size);
+    host_board().attach(0);
+    return false;
+  }
+
+  PinCostMeter meter(wiring_type, chip_type);
+  const uint32_t memory_size = programmer.get_memory_size_bytes();
+  const uint32_t pages = memory_size / page_size;
+  // spread the addresses, so the high address bits toggle as well
+  std::vector<uint32_t> addresses;
+  for (uint32_t i = 0; i < samples; i++) {
+    addresses.push_back((uint32_t)(((uint64_t)i * 0x9E5) % memory_size));
+  }
+  std::vector<uint8_t> page(page_size);
+
+  std::vector<OpCost> costs;
+  OpCost cost;
+
+  cost = OpCost();
+  cost.op = "set_read_mode";
+  for (uint32_t i = 0; i < samples; i++) {
+    meter.begin();
+    meter.end(cost, programmer.set_read_mode(page_size));
+  }
+  costs.push_back(cost);
+
+  cost = OpCost();
+  cost.op = "read_byte";
+  for (uint32_t address : addresses) {
+    uint8_t byte = 0;
+    meter.begin();
+    meter.end(cost, programmer.read_byte(address, byte));
+  }
+  costs.push_back(cost);
+
+  cost = OpCost();
+  cost.op = "read_page";
+  for (uint32_t i = 0; i < samples; i++) {
+    meter.begin();
+    meter.end(cost, programmer.read_page(i % pages, page.data()));
+  }
+  costs.push_back(cost);
+
+  cost = OpCost();
+  cost.op = "set_write_mode";
+  for (uint32_t i = 0; i < samples; i++) {
+    meter.begin();
+    meter.end(cost, programmer.set_write_mode(page_size));
+  }
+  costs.push_back(cost);
+
+  cost = OpCost();
+  cost.op = "write_byte";
+  for (uint32_t i = 0; i < samples; i++) {
+    meter.begin();
+    meter.end(cost, programmer.write_byte(addresses[i], (uint8_t)(i * 37)));
+  }
+  costs.push_back(cost);
+
+  cost = OpCost();
+  cost.op = "write_page";
+  for (uint32_t i = 0; i < samples; i++) {
+    for (uint32_t j = 0; j < page_size; j++) {
+      page[j] = (uint8_t)(i + j * 11);
+    }
+    meter.begin();
+    meter.end(cost, programmer.write_page(i % pages, page.data(), page_size));
+  }
+  costs.push_back(cost);
+
+  const Sim28CxxStats& stats = chip.stats();
+  printf("    {\"chip\": \"%s\", \"wiring\": \"%s\", \"page_size\": %u, \"samples\": %u,\n", chip_name,
+         wiring_type == WiringType::DIP28_SHIFT ? "DIP28_SHIFT" : "DIP28", page_size, samples);
+  printf("      \"sim\": {\"timing_violations\": %u, \"bus_contentions\": %u, \"write_cycles\": %u},\n",
+         stats.timing_violations, stats.bus_contentions, stats.write_cycles);
+  printf("      \"ops\": [\n");
+  for (size_t i = 0; i < costs.size(); i++) {
+    print_op(costs[i], i + 1 == costs.size());
+  }
+  printf("      ]}%s\n", last ? "" : ",");
+
+  host_board().attach(0);
+  return true;
+}
+
+static void usage(const char* name) {
+  fprintf(stderr,
+          "usage: %s [--wiring DIP28|DIP28_SHIFT] [--chip AT28C64|AT28C256|AT28C16]... [--page-size <bytes>] [--samples <n>]\n"
+          "  DIP28 and all writable chips of the wiring by default\n",
+          name);
+}
+
+int main(int argc, char** argv) {
+  WiringType wiring_type = WiringType::DIP28;
+  std::vector<const char*> chips;
+  uint32_t page_size = 64;
+  uint32_t samples = 64;
+
+  for (int i = 1; i < argc; i++) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--wiring") == 0 && has_value) {
+      const char* wiring_name = argv[++i];
+      if (strcasecmp(wiring_name, "DIP28") == 0) {
+        wiring_type = WiringType::DIP28;
+      } else if (strcasecmp(wiring_name, "DIP28_SHIFT") == 0) {
+        wiring_type = WiringType::DIP28_SHIFT;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--chip") == 0 && has_value) {
+      chips.push_back(argv[++i]);
+    } else if (strcmp(argv[i], "--page-size") == 0 && has_value) {
+      page_size = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--samples") == 0 && has_value) {
+      samples = strtoul(argv[++i], NULL, 10);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (chips.empty()) {
+    chips.push_back("AT28C64");
+    chips.push_back("AT28C256");
+    if (wiring_type == WiringType::DIP28) {
+      chips.push_back("AT28C16");
+    }
+  }
+  if (page_size < 1 || samples < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const HostTiming& timing = host_board().timing;
+  printf("{\n  \"report\": \"pin_cost\",\n");
+  printf("  \"timing\": {\"pin_mode_nsec\": %u, \"digital_write_nsec\": %u, \"digital_read_nsec\": %u, \"micros_nsec\": %u},\n",
+         timing.pin_mode_nsec, timing.digital_write_nsec, timing.digital_read_nsec, timing.micros_nsec);
+  printf("  \"chips\": [\n");
+  for (size_t i = 0; i < chips.size(); i++) {
+    if (!measure_chip(wiring_type, chips[i], page_size, samples, i + 1 == chips.size())) {
+      return 1;
+    }
+  }
+  printf("  ]\n}\n");
+
+  return 0;
+}
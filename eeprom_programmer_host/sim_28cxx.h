@@ -0,0 +1,274 @@
+// Simulated 28Cxx parallel EEPROM for the host build
+// wired to the board pins through the same WiringController as the firmware
+
+#ifndef __sim_28cxx_h__
+#define __sim_28cxx_h__
+
+#include <vector>
+
+#include "Arduino.h"
+#include "../eeprom_programmer/eeprom_programmer_wiring.h"
+
+using namespace EepromProgrammerWiring;
+
+namespace EepromProgrammerHost {
+
+struct Sim28CxxConfig {
+  uint32_t page_size = 64;
+  // internal write cycle (tWC), starts when the byte load window closes
+  uint32_t write_cycle_usec = 1000;
+  // byte load cycle (tBLC), the next byte of a page must follow within it
+  uint32_t byte_load_window_usec = 150;
+  // address to output delay (tACC) and !OE to output delay (tOE)
+  uint32_t t_acc_nsec = 150;
+  uint32_t t_oe_nsec = 70;
+  uint8_t fill = 0xFF;
+};
+
+struct Sim28CxxStats {
+  uint32_t bytes_read = 0;
+  uint32_t bytes_loaded = 0;
+  uint32_t write_cycles = 0;
+  // data read before tACC/tOE passed
+  uint32_t timing_violations = 0;
+  // both the board and the chip drive the data bus
+  uint32_t bus_contentions = 0;
+};
+
+class Sim28Cxx : public HostDevice {
+public:
+  Sim28Cxx(const WiringType wiring_type, const ChipType chip_type, const Sim28CxxConfig& config)
+    : _config(config), _wiring_controller(wiring_type) {
+    _wiring_controller.set_chip_type(chip_type);
+    _address_bus_size = _wiring_controller.get_address_bus_pins(_address_bus_pins, WiringController::MAX_ADDRESS_BUS_SIZE);
+    _data_bus_size = _wiring_controller.get_data_bus_pins(_data_bus_pins, WiringController::MAX_DATA_BUS_SIZE);
+    PIN_NO management_pins[WiringController::MAX_MANAGEMENT_SIZE];
+    _wiring_controller.get_management_pins(management_pins, WiringController::MAX_MANAGEMENT_SIZE);
+    _chip_enable_pin = management_pins[0];
+    _output_enable_pin = management_pins[1];
+    _write_enable_pin = management_pins[2];
+    _rdy_busy_pin = management_pins[3];
+    // an EPROM needs VPP to program, !WE is not a write strobe
+    _read_only = _wiring_controller.get_chip_descriptor().write_completion == WriteCompletion::READ_ONLY;
+
+    // shift wirings: the low address bits come from the register outputs of the board
+    const size_t shift_address_size = _wiring_controller.get_shift_address_size();
+    if (shift_address_size > 0) {
+      PIN_NO latch_low_pin, latch_high_pin;
+      _wiring_controller.get_shift_latch_pins(latch_low_pin, latch_high_pin);
+      host_board().set_shift_latch_pin(0, latch_low_pin);
+      host_board().set_shift_latch_pin(1, latch_high_pin);
+      for (size_t i = 0; i < shift_address_size; i++) {
+        _address_bus_pins[i] = HOST_SHIFT_OUTPUT_PIN_BASE + i;
+      }
+    }
+
+    // the chip does not fit the wiring, `is_valid` reports it
+    if (is_valid()) {
+      _memory.assign((size_t)1 << _address_bus_size, config.fill);
+    }
+  }
+
+  bool is_valid() const {
+    return _address_bus_size > 0 && _address_bus_size <= WiringController::MAX_ADDRESS_BUS_SIZE && _data_bus_size == 8;
+  }
+
+  std::vector<uint8_t>& memory() {
+    return _memory;
+  }
+  const Sim28CxxStats& stats() const {
+    return _stats;
+  }
+
+  // HostDevice
+
+  void on_pin_change(const uint8_t pin) override {
+    const HostBoard& board = host_board();
+    const bool ce = board.pin_output(_chip_enable_pin) == LOW;
+    const bool oe = board.pin_output(_output_enable_pin) == LOW;
+    const bool we = board.pin_mode(_write_enable_pin) == OUTPUT && board.pin_output(_write_enable_pin) == LOW;
+
+    if (_is_address_pin(pin)) {
+      _address_changed_nsec = board.now_nsec();
+      _output_valid = false;
+    }
+    if (pin == _output_enable_pin && oe && !_oe) {
+      _oe_enabled_nsec = board.now_nsec();
+    }
+    if (!ce || !oe || we) {
+      // the next output enable is a new read cycle
+      _output_valid = false;
+    }
+
+    // !WE controlled write: the address latches on the falling edge, the data on the rising edge
+    if (ce && !oe) {
+      if (we && !_we) {
+        _latched_address = _read_address();
+      } else if (!we && _we) {
+        _load_byte(_latched_address, _read_data_bus());
+      }
+    }
+
+    if (ce && oe && !we) {
+      for (size_t i = 0; i < _data_bus_size; i++) {
+        if (board.pin_mode(_data_bus_pins[i]) == OUTPUT) {
+          _stats.bus_contentions++;
+          break;
+        }
+      }
+    }
+
+    _ce = ce;
+    _oe = oe;
+    _we = we;
+  }
+
+  bool drives_pin(const uint8_t pin, int& level) override {
+    if (_rdy_busy_pin > 0 && pin == _rdy_busy_pin) {
+      // open drain, low while busy
+      level = _is_busy() ? LOW : HIGH;
+      return true;
+    }
+    if (!_ce || !_oe || _we) {
+      return false;
+    }
+    for (size_t i = 0; i < _data_bus_size; i++) {
+      if (pin == _data_bus_pins[i]) {
+        level = (_output_data() >> i) & 1;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void on_time(const uint64_t now_nsec) override {
+    // byte load window closed, start the internal write cycle
+    if (_loading && now_nsec >= _last_load_nsec + (uint64_t)_config.byte_load_window_usec * 1000) {
+      _loading = false;
+      _write_cycle_end_nsec = now_nsec + (uint64_t)_config.write_cycle_usec * 1000;
+      _stats.write_cycles++;
+    }
+    // write cycle done, commit the page buffer
+    if (_write_cycle_end_nsec > 0 && now_nsec >= _write_cycle_end_nsec) {
+      _write_cycle_end_nsec = 0;
+      for (size_t i = 0; i < _page_buffer.size(); i++) {
+        _memory[_page_buffer[i].first] = _page_buffer[i].second;
+      }
+      _page_buffer.clear();
+      _output_valid = false;
+    }
+  }
+
+private:
+  Sim28CxxConfig _config;
+  Sim28CxxStats _stats;
+  WiringController _wiring_controller;
+
+  PIN_NO _address_bus_pins[WiringController::MAX_ADDRESS_BUS_SIZE];
+  size_t _address_bus_size;
+  PIN_NO _data_bus_pins[WiringController::MAX_DATA_BUS_SIZE];
+  size_t _data_bus_size;
+  PIN_NO _chip_enable_pin;
+  PIN_NO _output_enable_pin;
+  PIN_NO _write_enable_pin;
+  PIN_NO _rdy_busy_pin;
+  bool _read_only = false;
+
+  std::vector<uint8_t> _memory;
+
+  // control lines, true == active (low)
+  bool _ce = false;
+  bool _oe = false;
+  bool _we = false;
+
+  uint64_t _address_changed_nsec = 0;
+  uint64_t _oe_enabled_nsec = 0;
+  uint32_t _latched_address = 0;
+
+  // page buffer: (address, data) loaded during the current byte load window
+  std::vector<std::pair<uint32_t, uint8_t> > _page_buffer;
+  bool _loading = false;
+  uint64_t _last_load_nsec = 0;
+  uint64_t _write_cycle_end_nsec = 0;
+  uint8_t _last_loaded_data = 0;
+  bool _toggle_bit = false;
+
+  // output of the current read cycle, the board reads it pin by pin
+  uint8_t _output_latch = 0xFF;
+  bool _output_valid = false;
+
+  bool _is_address_pin(const uint8_t pin) const {
+    for (size_t i = 0; i < _address_bus_size; i++) {
+      if (pin == _address_bus_pins[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool _is_busy() const {
+    return _loading || _write_cycle_end_nsec > 0;
+  }
+
+  uint32_t _read_address() const {
+    uint32_t address = 0;
+    for (size_t i = 0; i < _address_bus_size; i++) {
+      address |= (uint32_t)(host_board().pin_output(_address_bus_pins[i]) & 1) << i;
+    }
+    return address;
+  }
+
+  uint8_t _read_data_bus() const {
+    uint8_t data = 0;
+    for (size_t i = 0; i < _data_bus_size; i++) {
+      data |= (host_board().pin_output(_data_bus_pins[i]) & 1) << i;
+    }
+    return data;
+  }
+
+  void _load_byte(const uint32_t address, const uint8_t data) {
+    const uint32_t page_mask = ~(_config.page_size - 1);
+    if (_read_only) {
+      return;
+    }
+    if (_write_cycle_end_nsec > 0) {
+      // writes are ignored during the internal write cycle
+      return;
+    }
+    if (_loading && !_page_buffer.empty() && (_page_buffer[0].first & page_mask) != (address & page_mask)) {
+      // a byte outside the current page starts a new load in the real chip
+      // the simulation ignores it like the datasheet's undefined behavior
+      return;
+    }
+    _page_buffer.push_back(std::make_pair(address, data));
+    _loading = true;
+    _last_load_nsec = host_board().now_nsec();
+    _last_loaded_data = data;
+    _stats.bytes_loaded++;
+  }
+
+  uint8_t _output_data() {
+    if (_output_valid) {
+      return _output_latch;
+    }
+    const uint64_t now_nsec = host_board().now_nsec();
+    if (_is_busy()) {
+      // DATA polling: complement of I/O7 of the last byte, I/O6 toggles on every read cycle
+      _toggle_bit = !_toggle_bit;
+      _output_latch = ((~_last_loaded_data) & 0x80) | (_toggle_bit ? 0x40 : 0x00) | (_last_loaded_data & 0x3F);
+    } else if (now_nsec < _address_changed_nsec + _config.t_acc_nsec || now_nsec < _oe_enabled_nsec + _config.t_oe_nsec) {
+      // the output is not valid yet, the pins float high
+      _stats.timing_violations++;
+      return 0xFF;
+    } else {
+      _output_latch = _memory[_read_address()];
+      _stats.bytes_read++;
+    }
+    _output_valid = true;
+    return _output_latch;
+  }
+};
+
+}  // EepromProgrammerHost
+
+#endif  // !__sim_28cxx_h__
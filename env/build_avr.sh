@@ -0,0 +1,44 @@
+# builds the sketch for the Arduino Mega 2560 with arduino-cli: the AVR-only code of the firmware
+# (the SRAM layout of memory_stats.h, the Timer1 instrument clock, input capture and pin interrupts)
+# compiles only here, the host builds take its fallbacks
+# the AVR core and ArduinoJson are pinned, the same ArduinoJson release as env/fetch_arduinojson.sh
+
+set -ex
+
+ARDUINO_AVR_CORE_VERSION=1.8.6
+ARDUINOJSON_VERSION=6.21.5
+FQBN=${FQBN:-arduino:avr:mega:cpu=atmega2560}
+BUILD_DIR=${BUILD_DIR:-./build}
+
+arduino-cli core update-index
+arduino-cli core install arduino:avr@${ARDUINO_AVR_CORE_VERSION}
+arduino-cli lib install ArduinoJson@${ARDUINOJSON_VERSION}
+
+# the default DIP28 wiring, then the DIP28_SHIFT board
+arduino-cli compile --fqbn ${FQBN} --warnings all \
+  --output-dir ${BUILD_DIR}/avr \
+  ./eeprom_programmer
+
+arduino-cli compile --fqbn ${FQBN} --warnings all \
+  --build-property "compiler.cpp.extra_flags=-DEEPROM_PROGRAMMER_WIRING=DIP28_SHIFT" \
+  --output-dir ${BUILD_DIR}/avr_shift \
+  ./eeprom_programmer
+
+# the pin-change timing of RDY/!BUSY, opt-in
+arduino-cli compile --fqbn ${FQBN} --warnings all \
+  --build-property "compiler.cpp.extra_flags=-DPIN_EDGE_PCINT" \
+  --output-dir ${BUILD_DIR}/avr_pcint \
+  ./eeprom_programmer
+
+# RDY/!BUSY rewired to the capture pin 48 and to the INT4 pin 2 of the shift board
+arduino-cli compile --fqbn ${FQBN} --warnings all \
+  --build-property "compiler.cpp.extra_flags=-DDIP28_SOCKET_PIN1=48" \
+  --output-dir ${BUILD_DIR}/avr_icp \
+  ./eeprom_programmer
+
+arduino-cli compile --fqbn ${FQBN} --warnings all \
+  --build-property "compiler.cpp.extra_flags=-DEEPROM_PROGRAMMER_WIRING=DIP28_SHIFT -DDIP28_SOCKET_PIN1=2" \
+  --output-dir ${BUILD_DIR}/avr_shift_int \
+  ./eeprom_programmer
+
+echo built: ${BUILD_DIR}/avr ${BUILD_DIR}/avr_shift ${BUILD_DIR}/avr_pcint ${BUILD_DIR}/avr_icp ${BUILD_DIR}/avr_shift_int
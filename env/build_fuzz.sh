@@ -0,0 +1,41 @@
+# builds the serial JSON RPC fuzz target
+# clang: libFuzzer with ASan/UBSan, other compilers: the standalone replay driver with ASan/UBSan
+# ArduinoJson is the release pinned by env/fetch_arduinojson.sh, override with ARDUINOJSON_DIR
+
+set -ex
+
+ARDUINOJSON_DIR=${ARDUINOJSON_DIR:-./deps/ArduinoJson-6.21.5/src}
+BUILD_DIR=${BUILD_DIR:-./build}
+
+if [ ! -f ${ARDUINOJSON_DIR}/ArduinoJson.h ]; then
+  echo "ArduinoJson not found in ${ARDUINOJSON_DIR}, run env/fetch_arduinojson.sh"
+  exit 1
+fi
+
+mkdir -p ${BUILD_DIR}
+
+# the firmware sources build warning-free, the library headers are system headers
+WARNINGS="-Wall -Wextra -Werror"
+
+# zero-length VLAs (no params, no page mode yet) are accepted by avr-gcc and never dereferenced
+SANITIZERS="-fsanitize=address,undefined -fno-sanitize=vla-bound"
+
+if ${CXX:-clang++} --version 2>/dev/null | grep -q clang; then
+  ${CXX:-clang++} -std=gnu++17 -O1 -g ${WARNINGS} \
+    -fsanitize=fuzzer ${SANITIZERS} \
+    -DARDUINOJSON_ENABLE_PROGMEM=0 -DSTAGE_TRACE_DEPTH=16 \
+    -I ./eeprom_programmer_host \
+    -isystem ${ARDUINOJSON_DIR} \
+    ./eeprom_programmer_host/fuzz_json_rpc.cpp \
+    -o ${BUILD_DIR}/fuzz_json_rpc
+else
+  ${CXX:-g++} -std=gnu++17 -O1 -g ${WARNINGS} \
+    ${SANITIZERS} -DFUZZ_STANDALONE \
+    -DARDUINOJSON_ENABLE_PROGMEM=0 -DSTAGE_TRACE_DEPTH=16 \
+    -I ./eeprom_programmer_host \
+    -isystem ${ARDUINOJSON_DIR} \
+    ./eeprom_programmer_host/fuzz_json_rpc.cpp \
+    -o ${BUILD_DIR}/fuzz_json_rpc
+fi
+
+echo built: ${BUILD_DIR}/fuzz_json_rpc
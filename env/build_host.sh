@@ -0,0 +1,57 @@
+# builds the firmware for the host, with the simulated 28Cxx chip
+# ArduinoJson is the release pinned by env/fetch_arduinojson.sh, override with ARDUINOJSON_DIR
+
+set -ex
+
+ARDUINOJSON_DIR=${ARDUINOJSON_DIR:-./deps/ArduinoJson-6.21.5/src}
+BUILD_DIR=${BUILD_DIR:-./build}
+
+if [ ! -f ${ARDUINOJSON_DIR}/ArduinoJson.h ]; then
+  echo "ArduinoJson not found in ${ARDUINOJSON_DIR}, run env/fetch_arduinojson.sh"
+  exit 1
+fi
+
+mkdir -p ${BUILD_DIR}
+
+# the firmware sources build warning-free, the library headers are system headers
+WARNINGS="-Wall -Wextra -Werror"
+
+# the host firmware records the stage trace, the board builds leave it off
+${CXX:-g++} -std=gnu++17 -O2 ${WARNINGS} \
+  -DARDUINOJSON_ENABLE_PROGMEM=0 -DSTAGE_TRACE_DEPTH=256 \
+  -I ./eeprom_programmer_host \
+  -isystem ${ARDUINOJSON_DIR} \
+  ./eeprom_programmer_host/eeprom_programmer_host.cpp \
+  -o ${BUILD_DIR}/eeprom_programmer_host
+
+# the same firmware on the DIP28_SHIFT board, the address bus on two 74HC595 over SPI
+${CXX:-g++} -std=gnu++17 -O2 ${WARNINGS} \
+  -DARDUINOJSON_ENABLE_PROGMEM=0 -DSTAGE_TRACE_DEPTH=256 -DEEPROM_PROGRAMMER_WIRING=DIP28_SHIFT \
+  -I ./eeprom_programmer_host \
+  -isystem ${ARDUINOJSON_DIR} \
+  ./eeprom_programmer_host/eeprom_programmer_host.cpp \
+  -o ${BUILD_DIR}/eeprom_programmer_host_shift
+
+# pin-operation cost report of the bus engine, the library only
+${CXX:-g++} -std=gnu++17 -O2 ${WARNINGS} \
+  -I ./eeprom_programmer_host \
+  ./eeprom_programmer_host/pin_cost.cpp \
+  -o ${BUILD_DIR}/eeprom_programmer_pin_cost
+
+# request path throughput and heap use of the serial JSON RPC board
+${CXX:-g++} -std=gnu++17 -O2 ${WARNINGS} \
+  -DARDUINOJSON_ENABLE_PROGMEM=0 \
+  -I ./eeprom_programmer_host \
+  -isystem ${ARDUINOJSON_DIR} \
+  ./eeprom_programmer_host/json_rpc_bench.cpp \
+  -o ${BUILD_DIR}/json_rpc_bench
+
+# the longest write_page request against the request document capacity
+${CXX:-g++} -std=gnu++17 -O2 ${WARNINGS} \
+  -DARDUINOJSON_ENABLE_PROGMEM=0 \
+  -I ./eeprom_programmer_host \
+  -isystem ${ARDUINOJSON_DIR} \
+  ./eeprom_programmer_host/json_rpc_capacity_test.cpp \
+  -o ${BUILD_DIR}/json_rpc_capacity_test
+
+echo built: ${BUILD_DIR}/eeprom_programmer_host ${BUILD_DIR}/eeprom_programmer_host_shift ${BUILD_DIR}/eeprom_programmer_pin_cost ${BUILD_DIR}/json_rpc_bench ${BUILD_DIR}/json_rpc_capacity_test
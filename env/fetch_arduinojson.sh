@@ -0,0 +1,15 @@
+# fetches the ArduinoJson release the firmware is built and tested against into ./deps
+# the host and fuzz builds use it unless ARDUINOJSON_DIR points elsewhere
+
+set -ex
+
+ARDUINOJSON_VERSION=6.21.5
+DEPS_DIR=${DEPS_DIR:-./deps}
+
+if [ ! -d ${DEPS_DIR}/ArduinoJson-${ARDUINOJSON_VERSION} ]; then
+  mkdir -p ${DEPS_DIR}
+  git clone --depth 1 --branch v${ARDUINOJSON_VERSION} https://github.com/bblanchon/ArduinoJson.git \
+    ${DEPS_DIR}/ArduinoJson-${ARDUINOJSON_VERSION}
+fi
+
+echo ArduinoJson: ${DEPS_DIR}/ArduinoJson-${ARDUINOJSON_VERSION}/src